@@ -0,0 +1,248 @@
+// ARP Cache Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL w/ ENC28J60
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "eth0.h"
+#include "arp.h"
+#include "log.h"
+
+#define ARP_FREE     0
+#define ARP_PENDING  1
+#define ARP_RESOLVED 2
+
+#define ARP_SETS (ARP_CACHE_SIZE / ARP_CACHE_WAYS)
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _arpEntry
+{
+  uint8_t ip[4];
+  uint8_t mac[6];
+  uint8_t state;
+  uint8_t retries;       // requests sent while pending or refreshing
+  uint16_t ttl;          // seconds until expiry (resolved) or next request (pending)
+  bool used;             // looked up since last refresh, so worth refreshing
+} arpEntry;
+
+typedef struct _arpQueueEntry
+{
+  uint8_t ip[4];
+  pbuf* frame;           // NULL if slot is free
+  uint8_t order;         // arrival, frames for an ip leave oldest first
+} arpQueueEntry;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+arpEntry arpCache[ARP_CACHE_SIZE];
+arpQueueEntry arpQueue[ARP_QUEUE_SIZE];
+uint8_t arpQueueOrder = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Returns first entry of the set holding ip
+arpEntry* arpGetSet(const uint8_t ip[4])
+{
+    return &arpCache[((ip[2] ^ ip[3]) % ARP_SETS) * ARP_CACHE_WAYS];
+}
+
+// Returns the entry for ip or NULL if not cached
+arpEntry* arpFind(const uint8_t ip[4])
+{
+    arpEntry* entry = arpGetSet(ip);
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_WAYS; i++)
+    {
+        if (entry[i].state != ARP_FREE && memcmp(entry[i].ip, ip, 4) == 0)
+            return &entry[i];
+    }
+    return NULL;
+}
+
+// Sends queued frames for ip in the order they were queued, or frees them
+// if resolution failed (mac is NULL)
+void arpFlushQueue(const uint8_t ip[4], const uint8_t mac[6])
+{
+    arpQueueEntry* oldest;
+    uint8_t i;
+    do
+    {
+        // slots are reused, so the order is by arrival and not by slot
+        oldest = NULL;
+        for (i = 0; i < ARP_QUEUE_SIZE; i++)
+        {
+            if (arpQueue[i].frame != NULL && memcmp(arpQueue[i].ip, ip, 4) == 0
+                && (oldest == NULL || (int8_t)(arpQueue[i].order - oldest->order) < 0))
+                oldest = &arpQueue[i];
+        }
+        if (oldest != NULL)
+        {
+            if (mac != NULL)
+            {
+                memcpy(oldest->frame->data, mac, 6);
+                etherQueueFrame(oldest->frame);
+            }
+            else
+                pbufFree(oldest->frame);
+            oldest->frame = NULL;
+        }
+    }
+    while (oldest != NULL);
+}
+
+// Returns a free entry in the set for ip, evicting the one closest to expiry
+// Frames waiting on an evicted pending entry are freed
+arpEntry* arpAlloc(const uint8_t ip[4])
+{
+    arpEntry* entry = arpGetSet(ip);
+    arpEntry* victim = entry;
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_WAYS; i++)
+    {
+        if (entry[i].state == ARP_FREE)
+            return &entry[i];
+        // never evict a resolved entry in favor of a pending one
+        if (entry[i].state == ARP_PENDING || (victim->state == ARP_RESOLVED && entry[i].ttl < victim->ttl))
+            victim = &entry[i];
+    }
+    if (victim->state == ARP_PENDING)
+        arpFlushQueue(victim->ip, NULL);
+    return victim;
+}
+
+void arpSendRequest(arpEntry* entry)
+{
+    uint8_t request[42];
+    etherSendArpRequest(request, entry->ip);
+    LOG1(LOG_ARP_REQUEST, LOG_IP(entry->ip));
+    entry->retries++;
+}
+
+// Adds or refreshes a mapping, then sends any frames waiting on it
+void arpUpdate(const uint8_t ip[4], const uint8_t mac[6])
+{
+    arpEntry* entry = arpFind(ip);
+    if (entry == NULL)
+    {
+        entry = arpAlloc(ip);
+        memcpy(entry->ip, ip, 4);
+    }
+    else if (entry->state == ARP_PENDING)
+        LOG1(LOG_ARP_RESOLVED, LOG_IP(ip));
+    memcpy(entry->mac, mac, 6);
+    entry->state = ARP_RESOLVED;
+    entry->ttl = ARP_TIMEOUT;
+    entry->retries = 0;
+    entry->used = false;
+    arpFlushQueue(ip, mac);
+}
+
+// Adds a mapping remembered from a previous run
+// It is usable right away but is re-verified within ARP_REFRESH_TIME
+void arpPrime(const uint8_t ip[4], const uint8_t mac[6])
+{
+    arpEntry* entry;
+    arpUpdate(ip, mac);
+    entry = arpFind(ip);
+    entry->ttl = ARP_REFRESH_TIME;
+    entry->used = true;
+}
+
+// Gets mac for a next-hop ip address
+// Returns false and starts resolution (without waiting) if not cached
+bool arpLookup(const uint8_t ip[4], uint8_t mac[6])
+{
+    arpEntry* entry = arpFind(ip);
+    if (entry != NULL && entry->state == ARP_RESOLVED)
+    {
+        memcpy(mac, entry->mac, 6);
+        entry->used = true;
+        return true;
+    }
+    if (entry == NULL)
+    {
+        entry = arpAlloc(ip);
+        memcpy(entry->ip, ip, 4);
+        entry->state = ARP_PENDING;
+        entry->retries = 0;
+        entry->ttl = ARP_RETRY_TIME;
+        arpSendRequest(entry);
+    }
+    return false;
+}
+
+// Holds a frame waiting on ip, the destination mac is filled in when resolved
+// Takes ownership of the frame unless the queue is full (returns false)
+bool arpQueueFrame(const uint8_t ip[4], pbuf* frame)
+{
+    uint8_t i;
+    for (i = 0; i < ARP_QUEUE_SIZE; i++)
+    {
+        if (arpQueue[i].frame == NULL)
+        {
+            memcpy(arpQueue[i].ip, ip, 4);
+            arpQueue[i].frame = frame;
+            arpQueue[i].order = arpQueueOrder++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ages entries, retries pending requests and refreshes entries in use before they expire
+// Must be called once per second
+void arpTick()
+{
+    arpEntry* entry;
+    uint8_t i;
+    for (i = 0; i < ARP_CACHE_SIZE; i++)
+    {
+        entry = &arpCache[i];
+        if (entry->state == ARP_FREE)
+            continue;
+        if (entry->ttl > 0)
+            entry->ttl--;
+        if (entry->state == ARP_PENDING)
+        {
+            if (entry->ttl == 0)
+            {
+                if (entry->retries >= ARP_MAX_RETRIES)
+                {
+                    arpFlushQueue(entry->ip, NULL);
+                    entry->state = ARP_FREE;
+                }
+                else
+                {
+                    arpSendRequest(entry);
+                    entry->ttl = ARP_RETRY_TIME;
+                }
+            }
+        }
+        else
+        {
+            if (entry->ttl == 0)
+                entry->state = ARP_FREE;
+            else if (entry->used && entry->ttl <= ARP_REFRESH_TIME
+                     && (entry->ttl % ARP_RETRY_TIME) == 0 && entry->retries < ARP_MAX_RETRIES)
+                arpSendRequest(entry);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+// ARP Cache Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL w/ ENC28J60
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ARP_H_
+#define ARP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pbuf.h"
+
+// Cache is 2-way set associative, hashed on the low ip octets
+#define ARP_CACHE_SIZE       8
+#define ARP_CACHE_WAYS       2
+
+// Times in seconds (arpTick is called once per second)
+#define ARP_TIMEOUT          1200    // resolved entry lifetime
+#define ARP_REFRESH_TIME     60      // start refreshing this long before expiry
+#define ARP_RETRY_TIME       1       // time between requests for an entry
+#define ARP_MAX_RETRIES      5       // requests sent before giving up
+
+// Frames waiting for resolution
+#define ARP_QUEUE_SIZE       2
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void arpUpdate(const uint8_t ip[4], const uint8_t mac[6]);
+void arpPrime(const uint8_t ip[4], const uint8_t mac[6]);
+bool arpLookup(const uint8_t ip[4], uint8_t mac[6]);
+bool arpQueueFrame(const uint8_t ip[4], pbuf* frame);
+void arpTick();
+
+#endif
@@ -0,0 +1,50 @@
+// System Clock Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration:
+// 16 MHz external crystal
+
+// Sets up the PLL once for the whole program. Every divisor (uart baud
+// rate, ssi clock, SysTick reload, busy waits) is derived from SYSTEM_CLOCK
+// so changing CLOCK_SYSDIV is enough to change the clock. Speeds above
+// 50 MHz need the 400 MHz PLL output, which only RCC2 can select.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Runs the system clock from the PLL at SYSTEM_CLOCK
+void initClock()
+{
+    uint32_t rcc2;
+
+    // run from the crystal while the PLL is changed
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_USERCC2 | SYSCTL_RCC2_BYPASS2;
+    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | SYSCTL_RCC_BYPASS;
+
+    // main oscillator, PLL powered, 400 MHz output divided by CLOCK_SYSDIV
+    // (the divisor is SYSDIV2:SYSDIV2LSB + 1)
+    rcc2 = SYSCTL_RCC2_R;
+    rcc2 &= ~(SYSCTL_RCC2_OSCSRC2_M | SYSCTL_RCC2_PWRDN2 | SYSCTL_RCC2_SYSDIV2_M | SYSCTL_RCC2_SYSDIV2LSB);
+    rcc2 |= SYSCTL_RCC2_OSCSRC2_MO | SYSCTL_RCC2_DIV400 | ((CLOCK_SYSDIV - 1) << 22);
+    SYSCTL_RCC2_R = rcc2;
+
+    // switch over once the PLL has locked
+    while ((SYSCTL_RIS_R & SYSCTL_RIS_PLLLRIS) == 0);
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_BYPASS2;
+}
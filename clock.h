@@ -0,0 +1,35 @@
+// System Clock Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+// System clock is the 400 MHz PLL output divided by CLOCK_SYSDIV
+// 5 gives 80 MHz (the part's maximum), 10 gives the original 40 MHz
+#ifndef CLOCK_SYSDIV
+#define CLOCK_SYSDIV  5
+#endif
+
+#define SYSTEM_CLOCK  (400000000 / CLOCK_SYSDIV)
+#define CLOCKS_PER_US (SYSTEM_CLOCK / 1000000)
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initClock();
+
+#endif
@@ -0,0 +1,121 @@
+// Configuration Store
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// The configuration is loaded into cfg once at boot and only read from RAM
+// afterwards. Commits go to the next of CONFIG_SLOTS eeprom blocks in turn,
+// with a higher sequence number and the crc in the last word, so a commit
+// interrupted by a reset leaves the previous slot as the newest valid one.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "eeprom.h"
+#include "config.h"
+
+#define CONFIG_WORDS (sizeof(config) / 4)
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+config cfg;
+uint8_t configSlot = CONFIG_SLOTS - 1;   // slot cfg was loaded from or last committed to
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Reflected crc-32 (polynomial 0x04C11DB7), bitwise since it only runs at boot
+// and on commit
+uint32_t crc32(const void* data, uint16_t size)
+{
+    const uint8_t* p = data;
+    uint32_t crc = 0xFFFFFFFF;
+    uint8_t i;
+    while (size-- > 0)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+bool isConfigValid(const config* c)
+{
+    return c->fields.version == CONFIG_VERSION && c->fields.size == sizeof(config)
+           && c->fields.crc == crc32(c, sizeof(config) - 4);
+}
+
+void setDefaultConfig()
+{
+    const uint8_t mac[6] = {2, 3, 4, 5, 6, 7};
+    const uint8_t ip[4] = {192, 168, 10, 138};
+    const uint8_t subnetMask[4] = {255, 255, 255, 0};
+    const uint8_t gateway[4] = {192, 168, 10, 1};
+    const uint8_t broker[4] = {192, 168, 10, 2};
+    uint32_t legacyIp[4];
+    uint8_t i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.fields.version = CONFIG_VERSION;
+    cfg.fields.size = sizeof(config);
+    memcpy(cfg.fields.mac, mac, 6);
+    memcpy(cfg.fields.ip, ip, 4);
+    memcpy(cfg.fields.subnetMask, subnetMask, 4);
+    memcpy(cfg.fields.gateway, gateway, 4);
+    memcpy(cfg.fields.broker, broker, 4);
+    strcpy(cfg.fields.clientId, "hello");
+
+    // keep an address set with setip before the config store existed
+    readEepromBlock(EEPROM_LEGACY_IP_ADDRESS, legacyIp, 4);
+    if (legacyIp[0] <= 255 && legacyIp[1] <= 255 && legacyIp[2] <= 255 && legacyIp[3] <= 255)
+    {
+        for (i = 0; i < 4; i++)
+            cfg.fields.ip[i] = legacyIp[i];
+    }
+}
+
+// Loads the newest valid slot into cfg
+// Returns false and loads defaults if no slot is valid
+bool loadConfig()
+{
+    config slot;
+    bool found = false;
+    uint8_t i;
+    for (i = 0; i < CONFIG_SLOTS; i++)
+    {
+        readEepromBlock((EEPROM_CONFIG_BLOCK + i) * EEPROM_BLOCK_WORDS, slot.words, CONFIG_WORDS);
+        if (isConfigValid(&slot) && (!found || (int32_t)(slot.fields.sequence - cfg.fields.sequence) > 0))
+        {
+            cfg = slot;
+            configSlot = i;
+            found = true;
+        }
+    }
+    if (!found)
+        setDefaultConfig();
+    return found;
+}
+
+// Writes cfg to the next slot as one batch of word writes
+void commitConfig()
+{
+    configSlot = (configSlot + 1) % CONFIG_SLOTS;
+    cfg.fields.version = CONFIG_VERSION;
+    cfg.fields.size = sizeof(config);
+    cfg.fields.sequence++;
+    cfg.fields.crc = crc32(&cfg, sizeof(config) - 4);
+    writeEepromBlock((EEPROM_CONFIG_BLOCK + configSlot) * EEPROM_BLOCK_WORDS, cfg.words, CONFIG_WORDS);
+}
@@ -0,0 +1,55 @@
+// Configuration Store
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONFIG_VERSION        1
+#define CONFIG_SLOTS          4     // eeprom blocks used in rotation
+#define CONFIG_CLIENT_ID_SIZE 24    // mqtt 3.1.1 guarantees 23 characters
+
+// One slot fills one 16-word eeprom block
+typedef union _config
+{
+  struct
+  {
+    uint16_t version;
+    uint16_t size;
+    uint32_t sequence;       // incremented on every commit, newest valid slot wins
+    uint8_t mac[6];
+    uint8_t ip[4];
+    uint8_t subnetMask[4];
+    uint8_t gateway[4];
+    uint8_t broker[4];
+    char clientId[CONFIG_CLIENT_ID_SIZE];
+    uint8_t reserved[6];
+    uint32_t crc;            // crc-32 of everything above, written last
+  } fields;
+  uint32_t words[16];
+} config;
+
+extern config cfg;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint32_t crc32(const void* data, uint16_t size);
+bool loadConfig();
+void commitConfig();
+
+#endif
@@ -0,0 +1,77 @@
+// EEPROM Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "eeprom.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEeprom()
+{
+    SYSCTL_RCGCEEPROM_R = 1;
+    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+}
+
+void writeEeprom(uint16_t add, uint32_t eedata)
+{
+    EEPROM_EEBLOCK_R = add >> 4;
+    EEPROM_EEOFFSET_R = add & 0xF;
+    EEPROM_EERDWR_R = eedata;
+    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+}
+
+uint32_t readEeprom(uint16_t add)
+{
+    EEPROM_EEBLOCK_R = add >> 4;
+    EEPROM_EEOFFSET_R = add & 0xF;
+    return EEPROM_EERDWR_R;
+}
+
+// Writes count consecutive words starting at add
+// The block and offset are set once and the offset auto-increments, so each
+// word only costs the program cycle itself
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint8_t count)
+{
+    uint8_t i;
+    for (i = 0; i < count; i++)
+    {
+        // offset wraps within a block, so move to the next block explicitly
+        if (i == 0 || ((add + i) & 0xF) == 0)
+        {
+            EEPROM_EEBLOCK_R = (add + i) >> 4;
+            EEPROM_EEOFFSET_R = (add + i) & 0xF;
+        }
+        EEPROM_EERDWRINC_R = data[i];
+        while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+    }
+}
+
+// Reads count consecutive words starting at add
+void readEepromBlock(uint16_t add, uint32_t data[], uint8_t count)
+{
+    uint8_t i;
+    for (i = 0; i < count; i++)
+    {
+        if (i == 0 || ((add + i) & 0xF) == 0)
+        {
+            EEPROM_EEBLOCK_R = (add + i) >> 4;
+            EEPROM_EEOFFSET_R = (add + i) & 0xF;
+        }
+        data[i] = EEPROM_EERDWRINC_R;
+    }
+}
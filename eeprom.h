@@ -0,0 +1,39 @@
+// EEPROM Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EEPROM_BLOCK_WORDS 16
+
+// Layout (16-word blocks)
+// Block 0 held the ip address in words 1-4 before the config store
+#define EEPROM_LEGACY_IP_ADDRESS  1
+#define EEPROM_WARM_START_BLOCK   1
+#define EEPROM_CONFIG_BLOCK       2    // first of EEPROM_CONFIG_SLOTS blocks
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEeprom();
+void writeEeprom(uint16_t add, uint32_t eedata);
+uint32_t readEeprom(uint16_t add);
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint8_t count);
+void readEepromBlock(uint16_t add, uint32_t data[], uint8_t count);
+
+#endif
@@ -7,14 +7,14 @@
 
 // Target Platform: EK-TM4C123GXL w/ ENC28J60
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // ENC28J60 Ethernet controller on SPI0
 //   MOSI (SSI0Tx) on PA5
 //   MISO (SSI0Rx) on PA4
 //   SCLK (SSI0Clk) on PA2
-//   ~CS (SW controlled) on PA3
+//   ~CS (SW controlled, or SSI0Fss with ETHER_SSI_FSS) on PA3
 //   WOL on PB3
 //   INT on PC6
 
@@ -28,16 +28,42 @@
 #include <string.h>
 #include <stdlib.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "wait.h"
 #include "gpio.h"
 #include "spi0.h"
 #include "shell.h"
+#include "arp.h"
+#include "pbuf.h"
+#include "eeprom.h"
+#include "uart0.h"
+#include "perf.h"
+#include "format.h"
+#include "timer.h"
+#include "ring.h"
+#include "ramfunc.h"
 
 // Pins
 #define CS PORTA,3
 #define WOL PORTB,3
 #define INT PORTC,6
 
+// Define ETHER_SSI_FSS to let the SSI drive ~CS (SSI0Fss) for register
+// access, each one a single 16-bit frame, instead of two gpio writes
+// SSI0Fss only leads the first SCK edge by half a bit time, so SCK has to
+// drop to 10 MHz to meet the 50 ns CS setup time
+// Otherwise SCK is the fastest the ENC28J60 accepts (datasheet max 20 MHz),
+// which the SSI reaches as SYSTEM_CLOCK / 2 at 40 MHz or / 4 at 80 MHz
+#ifdef ETHER_SSI_FSS
+#define ETHER_SPI_CLOCK 10000000
+#else
+#define ETHER_SPI_CLOCK 20000000
+#endif
+
+// CS setup is 50 ns and hold 10 ns, but 210 ns after MAC and MII registers
+#define ETHER_CS_SETUP_CYCLES    ((50 * CLOCKS_PER_US + 999) / 1000)
+#define ETHER_CS_HOLD_MAC_CYCLES ((210 * CLOCKS_PER_US + 999) / 1000)
+
 // Ether registers
 #define ERDPTL      0x00
 #define ERDPTH      0x01
@@ -56,6 +82,8 @@
 #define ERXWRPTL    0x0E
 #define ERXWRPTH    0x0F
 #define EIE         0x1B
+#define INTIE   0x80
+#define PKTIE   0x40
 #define EIR         0x1C
 #define RXERIF  0x01
 #define TXERIF  0x02
@@ -69,6 +97,12 @@
 #define ECON1       0x1F
 #define RXEN    0x04
 #define TXRTS   0x08
+#define EHT0        0x20
+#define EPMM0       0x28
+#define EPMCSL      0x30
+#define EPMCSH      0x31
+#define EPMOL       0x34
+#define EPMOH       0x35
 #define ERXFCON     0x38
 #define EPKTCNT     0x39
 #define MACON1      0x40
@@ -107,10 +141,14 @@
 #define MIBUSY  0x01
 #define ECOCON      0x75
 
+// MAC and MII registers are bank 2 and MAADRx and MISTAT in bank 3
+#define ETHER_IS_MAC_MII(reg) ((reg) >= MACON1 && (reg) <= MISTAT && ((reg) & 0x1F) < EIE)
+
 // Ether phy registers
 #define PHCON1      0x00
 #define PDPXMD 0x0100
 #define PHSTAT1     0x01
+#define PHSTAT2     0x11
 #define LSTAT  0x0400
 #define PHCON2      0x10
 #define HDLDIS 0x0100
@@ -120,6 +158,29 @@
 #define IP_ADD_LENGTH 4
 #define HW_ADD_LENGTH 6
 
+// Buffer layout
+#define TX_BUFFER_START 0x1A0A
+// frame plus control byte and 7 byte tx status vector must fit in 0x1A0A-0x1FFF
+#define MAX_TX_FRAME_SIZE 1514
+
+// TCP
+#define TCP_FIN 0x0001
+#define TCP_SYN 0x0002
+#define TCP_RST 0x0004
+#define TCP_PSH 0x0008
+#define TCP_ACK 0x0010
+#define TCP_MSS 1280
+#define TCP_WINDOW_SIZE 1280
+#define TCP_DEFAULT_MSS 536
+#define MQTT_PORT 1883
+#define MQTT_KEEPALIVE 60
+
+#define WARM_START_ADDRESS (EEPROM_WARM_START_BLOCK * EEPROM_BLOCK_WORDS)
+#define WARM_START_MAGIC 0x57524D31    // "WRM1"
+
+// Rx interrupts not yet seen by the main loop (power of 2)
+#define RX_EVENT_RING_SIZE 4
+
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
@@ -133,9 +194,33 @@ uint8_t ipAddress[IP_ADD_LENGTH] = {0,0,0,0};
 uint8_t ipSubnetMask[IP_ADD_LENGTH] = {255,255,255,0};
 uint8_t ipGwAddress[IP_ADD_LENGTH] = {192,168,10,1};
 bool    dhcpEnabled = true;
-uint8_t payload = 1;
 uint16_t checksum;
 uint16_t portNum;
+uint8_t mqttBrokerIp[IP_ADD_LENGTH] = {192,168,10,2};
+uint16_t mqttKeepAlive = MQTT_KEEPALIVE;
+const char* mqttClientId = "hello";
+uint16_t mqttPacketId = 0;
+uint16_t tcpMss = TCP_DEFAULT_MSS;
+bool    txSumOdd = false;
+bool    autoFilters = false;    // ERXFCON follows etherUpdateFilters
+uint8_t multicastGroups[ETHER_MULTICAST_GROUPS][HW_ADD_LENGTH];
+uint8_t multicastCount = 0;
+pbuf*   txQueueHead = NULL;     // frames waiting for the controller
+pbuf*   txQueueTail = NULL;
+pbuf*   txFrame = NULL;         // buffer of the frame being sent (NULL if streamed)
+bool    txBusy = false;
+uint16_t txSize = 0;
+etherStats netStats;
+uint32_t rxEventData[RX_EVENT_RING_SIZE];
+ring    rxEvents;               // etherIsr to main loop, tick of each interrupt
+bool    rxSignalled = false;    // interrupt seen, receive ring not yet emptied
+const char* const etherStatNames[ETHER_STAT_COUNT] =
+{
+    "rx", "rxB", "rxOvf", "rxTrunc", "tx", "txB", "txErr",
+    "ipCsum", "tcpCsum", "udpCsum", "arpRx", "arpTx", "arpQDrop",
+    "icmpRx", "tcpRx", "tcpTx", "tcpRetx", "udpRx",
+    "mqttTx", "pubTx", "pubRx", "ping"
+};
 
 // ------------------------------------------------------------------------------
 //  Structures
@@ -240,32 +325,36 @@ typedef struct _mqttFrame
 
 } mqttFrame;
 
-typedef struct _mqttPublishFrame
-{
-   uint8_t control;
-   uint8_t msgLength;
-   uint16_t topicLength;
-   uint8_t topicNameAndMessage[100];
-} mqttPublishFrame;
-
-typedef struct _mqttSubReqFrame
-{
-   uint8_t control;
-   uint8_t msgLength;
-   uint16_t msgID;
-   uint16_t topicLength;
-   uint8_t topicName[100];
-   uint8_t QoS;
-} mqttSubReqFrame;
-
-typedef struct _mqttUnSubReqFrame
-{
-   uint8_t control;
-   uint8_t msgLength;
-   uint16_t msgID;
-   uint16_t topicLength;
-   uint8_t topicName[100];
-} mqttUnSubReqFrame;
+typedef struct _tcpConnectionState
+{
+  uint8_t header[54];     // prebuilt ether + ip + tcp header
+  uint16_t ipCheck;       // ip header checksum with zero length
+  uint16_t tcpCheck;      // pseudo-header + tcp checksum with zero length, seq, ack, flags
+  uint32_t seqNum;        // next sequence number to send (host order)
+  uint32_t ackNum;        // next sequence number expected (host order)
+  uint8_t nextHop[4];     // broker or gateway ip used for arp resolution
+  uint16_t mss;           // largest segment the peer accepts
+} tcpConnectionState;
+
+// Session parameters kept across reboots so the first connection
+// after power-up skips discovery
+typedef union _warmStartRecord
+{
+  struct
+  {
+    uint32_t magic;
+    uint8_t nextHop[4];
+    uint8_t mac[6];
+    uint16_t mss;
+    uint16_t keepAlive;
+    uint16_t packetId;
+    uint16_t reserved;
+    uint16_t checksum;
+  } fields;
+  uint32_t words[6];
+} warmStartRecord;
+
+tcpConnectionState tcpConnection;
 
 
 //-----------------------------------------------------------------------------
@@ -276,60 +365,76 @@ typedef struct _mqttUnSubReqFrame
 // Receive buffer starts at 0x0000 (bottom 6666 bytes of 8K space)
 // Transmit buffer at 01A0A (top 1526 bytes of 8K space)
 
-void etherCsOn()
+// Chip select for transfers driven by software
+// With ETHER_SSI_FSS the pin is taken from the SSI for the transfer (its
+// data bit is already 0, so it goes straight low) and handed back after
+static inline void etherCsOn()
 {
-    setPinValue(CS, 0);
-    __asm (" NOP");                    // allow line to settle
-    __asm (" NOP");
-    __asm (" NOP");
-    __asm (" NOP");
+#ifdef ETHER_SSI_FSS
+    disablePinAuxFunction(CS);
+    setSpi0DataSize(8);
+#endif
+    setPinValueInline(CS, 0);
+    _delay_cycles(ETHER_CS_SETUP_CYCLES);  // allow line to settle
 }
 
-void etherCsOff()
+static inline void etherCsOff()
 {
-    setPinValue(CS, 1);
+    setPinValueInline(CS, 1);
+#ifdef ETHER_SSI_FSS
+    setSpi0DataSize(16);
+    enablePinAuxFunction(CS);
+    setPinValueInline(CS, 0);              // only seen at the next etherCsOn
+#endif
 }
 
-void etherWriteReg(uint8_t reg, uint8_t data)
+// Sends an opcode with a register address, then a data byte
+// Returns the byte clocked in with the data byte (the register for a read)
+static inline uint8_t etherRegOp(uint8_t op, uint8_t reg, uint8_t data)
 {
+    uint8_t result;
+    bool macMii = ETHER_IS_MAC_MII(reg);
+    PERF_BEGIN(PERF_ETHER_REG_OP);
+#ifdef ETHER_SSI_FSS
+    // MAC and MII registers need a longer CS hold than SSI0Fss gives
+    if (!macMii)
+    {
+        writeSpi0Data(((op | (reg & 0x1F)) << 8) | data);
+        result = readSpi0Data();
+        PERF_END(PERF_ETHER_REG_OP);
+        return result;
+    }
+#endif
     etherCsOn();
-    writeSpi0Data(0x40 | (reg & 0x1F));
+    writeSpi0Data(op | (reg & 0x1F));
     readSpi0Data();
     writeSpi0Data(data);
-    readSpi0Data();
+    result = readSpi0Data();
+    if (macMii)
+        _delay_cycles(ETHER_CS_HOLD_MAC_CYCLES);
     etherCsOff();
+    PERF_END(PERF_ETHER_REG_OP);
+    return result;
+}
+
+void etherWriteReg(uint8_t reg, uint8_t data)
+{
+    etherRegOp(0x40, reg, data);
 }
 
 uint8_t etherReadReg(uint8_t reg)
 {
-    uint8_t data;
-    etherCsOn();
-    writeSpi0Data(0x00 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(0);
-    data = readSpi0Data();
-    etherCsOff();
-    return data;
+    return etherRegOp(0x00, reg, 0);
 }
 
 void etherSetReg(uint8_t reg, uint8_t mask)
 {
-    etherCsOn();
-    writeSpi0Data(0x80 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(mask);
-    readSpi0Data();
-    etherCsOff();
+    etherRegOp(0x80, reg, mask);
 }
 
 void etherClearReg(uint8_t reg, uint8_t mask)
 {
-    etherCsOn();
-    writeSpi0Data(0xA0 | (reg & 0x1F));
-    readSpi0Data();
-    writeSpi0Data(mask);
-    readSpi0Data();
-    etherCsOff();
+    etherRegOp(0xA0, reg, mask);
 }
 
 void etherSetBank(uint8_t reg)
@@ -370,7 +475,7 @@ void etherWriteMemStart()
     readSpi0Data();
 }
 
-void etherWriteMem(uint8_t data)
+RAMFUNC void etherWriteMem(uint8_t data)
 {
     writeSpi0Data(data);
     readSpi0Data();
@@ -388,7 +493,7 @@ void etherReadMemStart()
     readSpi0Data();
 }
 
-uint8_t etherReadMem()
+RAMFUNC uint8_t etherReadMem()
 {
     writeSpi0Data(0);
     return readSpi0Data();
@@ -404,9 +509,16 @@ void etherReadMemStop()
 void etherInit(uint16_t mode)
 {
     // Initialize SPI0
+#ifdef ETHER_SSI_FSS
+    initSpi0(USE_SSI0_FSS | USE_SSI0_RX);
+#else
     initSpi0(USE_SSI0_RX);
-    setSpi0BaudRate(4e6, 40e6);
+#endif
+    setSpi0BaudRate(ETHER_SPI_CLOCK, SYSTEM_CLOCK);
     setSpi0Mode(0, 0);
+#ifdef ETHER_SSI_FSS
+    setSpi0DataSize(16);
+#endif
 
     // Enable clocks
     enablePort(PORTA);
@@ -417,6 +529,8 @@ void etherInit(uint16_t mode)
     selectPinPushPullOutput(CS);
     selectPinDigitalInput(WOL);
     selectPinDigitalInput(INT);
+    selectPinInterruptLowLevel(INT);
+    ringInit(&rxEvents, rxEventData, RX_EVENT_RING_SIZE, sizeof(uint32_t));
 
     // make sure that oscillator start-up timer has expired
     while ((etherReadReg(ESTAT) & CLKRDY) == 0) {}
@@ -442,9 +556,13 @@ void etherInit(uint16_t mode)
     etherWriteReg(ERDPTH, HIBYTE(0x0000));
 
     // setup receive filter
-    // always check CRC, use OR mode
-    etherSetBank(ERXFCON);
-    etherWriteReg(ERXFCON, (mode | ETHER_CHECKCRC) & 0xFF);
+    // with ETHER_AUTOFILTER they follow what the stack needs, otherwise
+    // they are fixed by mode
+    autoFilters = (mode & ETHER_AUTOFILTER) != 0;
+    if (autoFilters)
+        etherUpdateFilters();
+    else
+        etherSetReceiveFilters(mode & 0xFF);
 
     // bring mac out of reset
     etherSetBank(MACON2);
@@ -504,6 +622,11 @@ void etherInit(uint16_t mode)
     // stretch LED on to 40ms (default)
     etherWritePhy(PHLCON, 0x0472);
 
+    // interrupt on received packets, INT drives the PC6 isr
+    etherWriteReg(EIE, INTIE | PKTIE);
+    NVIC_EN0_R |= 1 << (INT_GPIOC-16);
+    enablePinInterrupt(INT);
+
     // enable reception
     etherSetReg(ECON1, RXEN);
 }
@@ -511,7 +634,34 @@ void etherInit(uint16_t mode)
 // Returns true if link is up
 bool etherIsLinkUp()
 {
-    return (etherReadPhy(PHSTAT1) & LSTAT) != 0;
+    return (etherReadPhy(PHSTAT2) & LSTAT) != 0;
+}
+
+// INT line (PC6, low level) isr
+// Hands the event to the main loop and masks the line, which stays low
+// until the receive ring is empty; etherIsRxPending unmasks it
+void etherIsr()
+{
+    uint32_t tick = timerGetTicks();
+    disablePinInterrupt(INT);
+    ringPut(&rxEvents, &tick);
+}
+
+// Returns true if a frame is waiting
+// Only reads the controller once the interrupt has fired, and re-arms the
+// interrupt when the receive ring is found empty
+bool etherIsRxPending()
+{
+    uint32_t tick;
+    while (ringGet(&rxEvents, &tick))
+        rxSignalled = true;
+    if (!rxSignalled)
+        return false;
+    if (etherIsDataAvailable())
+        return true;
+    rxSignalled = false;
+    enablePinInterrupt(INT);
+    return false;
 }
 
 // Returns TRUE if packet received
@@ -526,16 +676,22 @@ bool etherIsOverflow()
     bool err;
     err = (etherReadReg(EIR) & RXERIF) != 0;
     if (err)
+    {
         etherClearReg(EIR, RXERIF);
+        netStats.rxOverflows++;
+    }
     return err;
 }
 
-// Returns up to max_size characters in data buffer
-// Returns number of bytes copied to buffer
-// Contents written are 16-bit size, 16-bit status, payload excl crc
-uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
+// Takes the next frame out of the receive ring into a buffer from the pool
+// Contents are the frame excl crc; frames larger than a buffer are truncated
+// Returns NULL (the frame is dropped) if no buffer is free
+// The caller owns the buffer and must free it or pass it on
+RAMFUNC pbuf* etherGetFrame()
 {
+    pbuf* frame;
     uint16_t i = 0, size, tmp16, status;
+    PERF_BEGIN(PERF_ETHER_GET_FRAME);
 
     // enable read from FIFO buffers
     etherReadMemStart();
@@ -555,11 +711,22 @@ uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
     tmp16 = etherReadMem();
     status |= (tmp16 << 8);
 
+    netStats.rxFrames++;
+    netStats.rxBytes += size;
+
     // copy data
-    if (size > maxSize)
-        size = maxSize;
-    while (i < size)
-        packet[i++] = etherReadMem();
+    if (size > PBUF_LARGE_SIZE)
+    {
+        size = PBUF_LARGE_SIZE;
+        netStats.rxTruncated++;
+    }
+    frame = pbufAlloc(size);
+    if (frame != NULL)
+    {
+        while (i < size)
+            frame->data[i++] = etherReadMem();
+        frame->size = size;
+    }
 
     // end read from FIFO buffers
     etherReadMemStop();
@@ -574,14 +741,13 @@ uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize)
     // decrement packet counter so that PKTIF is maintained correctly
     etherSetReg(ECON2, PKTDEC);
 
-    return size;
+    PERF_END(PERF_ETHER_GET_FRAME);
+    return frame;
 }
 
-// Writes a packet
-bool etherPutPacket(uint8_t packet[], uint16_t size)
+// Sets up the tx buffer for a new frame, the controller must be idle
+void etherTxBegin()
 {
-    uint16_t i;
-
     // clear out any tx errors
     if ((etherReadReg(EIR) & TXERIF) != 0)
     {
@@ -592,8 +758,8 @@ bool etherPutPacket(uint8_t packet[], uint16_t size)
 
     // set DMA start address
     etherSetBank(EWRPTL);
-    etherWriteReg(EWRPTL, LOBYTE(0x1A0A));
-    etherWriteReg(EWRPTH, HIBYTE(0x1A0A));
+    etherWriteReg(EWRPTL, LOBYTE(TX_BUFFER_START));
+    etherWriteReg(EWRPTH, HIBYTE(TX_BUFFER_START));
 
     // start FIFO buffer write
     etherWriteMemStart();
@@ -601,36 +767,159 @@ bool etherPutPacket(uint8_t packet[], uint16_t size)
     // write control byte
     etherWriteMem(0);
 
-    // write data
+    txSumOdd = false;
+}
+
+// Starts a frame in the tx buffer
+// The frame being sent and any queued frames go first
+// Frame data is then streamed with etherTxWrite/etherTxWriteSum and sent with etherTxSend
+// No other controller access is allowed until etherTxSend returns
+void etherTxStart()
+{
+    etherTxFlush();
+    etherTxBegin();
+}
+
+// Streams data into the tx buffer
+RAMFUNC void etherTxWrite(const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+    for (i = 0; i < size; i++)
+        etherWriteMem(data[i]);
+}
+
+// Streams data into the tx buffer and adds it to sum in the same pass
+// Unlike etherSumWords, byte alignment is kept across calls so odd sized
+// pieces can be chained (first piece must start on an even offset)
+RAMFUNC void etherTxWriteSum(const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
     for (i = 0; i < size; i++)
-        etherWriteMem(packet[i]);
+    {
+        etherWriteMem(data[i]);
+        if (txSumOdd)
+            sum += (uint16_t)data[i] << 8;
+        else
+            sum += data[i];
+        txSumOdd = !txSumOdd;
+    }
+}
+
+// Overwrites data already streamed into the tx buffer (e.g. a checksum)
+// Offset is from the start of the frame; streaming continues after the patch
+void etherTxWriteAt(uint16_t offset, const uint8_t data[], uint16_t size)
+{
+    etherWriteMemStop();
+    // bank 0 is still selected by etherTxStart
+    etherWriteReg(EWRPTL, LOBYTE(TX_BUFFER_START + 1 + offset));
+    etherWriteReg(EWRPTH, HIBYTE(TX_BUFFER_START + 1 + offset));
+    etherWriteMemStart();
+    etherTxWrite(data, size);
+}
 
+// Sends the frame streamed since etherTxStart
+// Returns once the controller has the frame; etherTxComplete finishes up
+// and counts an aborted transmission in netStats.txErrors
+void etherTxSend(uint16_t size)
+{
     // stop write
     etherWriteMemStop();
-  
+
     // request transmit
-    etherWriteReg(ETXSTL, LOBYTE(0x1A0A));
-    etherWriteReg(ETXSTH, HIBYTE(0x1A0A));
-    etherWriteReg(ETXNDL, LOBYTE(0x1A0A+size));
-    etherWriteReg(ETXNDH, HIBYTE(0x1A0A+size));
+    etherWriteReg(ETXSTL, LOBYTE(TX_BUFFER_START));
+    etherWriteReg(ETXSTH, HIBYTE(TX_BUFFER_START));
+    etherWriteReg(ETXNDL, LOBYTE(TX_BUFFER_START+size));
+    etherWriteReg(ETXNDH, HIBYTE(TX_BUFFER_START+size));
     etherClearReg(EIR, TXIF);
     etherSetReg(ECON1, TXRTS);
 
-    // wait for completion
-    while ((etherReadReg(ECON1) & TXRTS) != 0);
+    txSize = size;
+    txBusy = true;
+}
+
+// Copies a frame from the pool to the controller and sends it
+void etherTxFrame(pbuf* frame)
+{
+    etherTxBegin();
+    etherTxWrite(frame->data, frame->size);
+    etherTxSend(frame->size);
+    txFrame = frame;
+}
+
+// Returns true once the controller has finished the frame being sent
+bool etherIsTxDone()
+{
+    return txBusy && (etherReadReg(ECON1) & TXRTS) == 0;
+}
+
+// Accounts for the frame just sent, frees its buffer and starts the next
+// queued frame; call once etherIsTxDone returns true
+void etherTxComplete()
+{
+    pbuf* frame;
+    netStats.txFrames++;
+    netStats.txBytes += txSize;
+    if (etherReadReg(ESTAT) & TXABORT)
+        netStats.txErrors++;
+    pbufFree(txFrame);
+    txFrame = NULL;
+    txBusy = false;
+    if (txQueueHead != NULL)
+    {
+        frame = txQueueHead;
+        txQueueHead = frame->next;
+        if (txQueueHead == NULL)
+            txQueueTail = NULL;
+        etherTxFrame(frame);
+    }
+}
+
+// Waits until the frame being sent and all queued frames are out
+void etherTxFlush()
+{
+    while (txBusy)
+    {
+        while ((etherReadReg(ECON1) & TXRTS) != 0);
+        etherTxComplete();
+    }
+}
+
+// Sends a frame from the pool, after the one being sent if the controller is busy
+// Takes ownership of the buffer, which is freed once the frame is on the wire
+void etherQueueFrame(pbuf* frame)
+{
+    frame->next = NULL;
+    if (!txBusy)
+        etherTxFrame(frame);
+    else
+    {
+        if (txQueueTail == NULL)
+            txQueueHead = frame;
+        else
+            txQueueTail->next = frame;
+        txQueueTail = frame;
+    }
+}
 
-    // determine success
-    return ((etherReadReg(ESTAT) & TXABORT) == 0);
+// Writes a packet
+void etherPutPacket(uint8_t packet[], uint16_t size)
+{
+    PERF_BEGIN(PERF_ETHER_PUT_PACKET);
+    etherTxStart();
+    etherTxWrite(packet, size);
+    etherTxSend(size);
+    PERF_END(PERF_ETHER_PUT_PACKET);
 }
 
 // Calculate sum of words
 // Must use getEtherChecksum to complete 1's compliment addition
-void etherSumWords(void* data, uint16_t sizeInBytes)
+RAMFUNC void etherSumWords(void* data, uint16_t sizeInBytes)
 {
 	uint8_t* pData = (uint8_t*)data;
     uint16_t i;
     uint8_t phase = 0;
     uint16_t data_temp;
+    PERF_BEGIN(PERF_ETHER_SUM_WORDS);
     for (i = 0; i < sizeInBytes; i++)
     {
         if (phase)
@@ -643,10 +932,11 @@ void etherSumWords(void* data, uint16_t sizeInBytes)
         phase = 1 - phase;
         pData++;
     }
+    PERF_END(PERF_ETHER_SUM_WORDS);
 }
 
 // Completes 1's compliment addition by folding carries back into field
-uint16_t getEtherChecksum()
+RAMFUNC uint16_t getEtherChecksum()
 {
     uint16_t result;
     // this is based on rfc1071
@@ -656,7 +946,26 @@ uint16_t getEtherChecksum()
     return ~result;
 }
 
-void etherCalcIpChecksum(ipFrame* ip)
+// Updates a checksum after a 16-bit field changes, without re-summing the data
+// Uses HC' = ~(~HC + ~m + m') from rfc1624 (avoids the -0 problem of rfc1141)
+// Values are passed as stored in the frame (network order)
+uint16_t etherUpdateChecksum16(uint16_t check, uint16_t oldValue, uint16_t newValue)
+{
+    uint32_t tmp32;
+    tmp32 = (uint16_t)~check + (uint16_t)~oldValue + newValue;
+    tmp32 = (tmp32 & 0xFFFF) + (tmp32 >> 16);
+    tmp32 = (tmp32 & 0xFFFF) + (tmp32 >> 16);
+    return ~tmp32;
+}
+
+// Updates a checksum after a 32-bit field changes (e.g. a sequence number or ip address)
+uint16_t etherUpdateChecksum32(uint16_t check, uint32_t oldValue, uint32_t newValue)
+{
+    check = etherUpdateChecksum16(check, oldValue & 0xFFFF, newValue & 0xFFFF);
+    return etherUpdateChecksum16(check, oldValue >> 16, newValue >> 16);
+}
+
+RAMFUNC void etherCalcIpChecksum(ipFrame* ip)
 {
     // 32-bit sum over ip header
     sum = 0;
@@ -666,7 +975,7 @@ void etherCalcIpChecksum(ipFrame* ip)
 }
 
 // Converts from host to network order and vice versa
-uint16_t htons(uint16_t value)
+RAMFUNC uint16_t htons(uint16_t value)
 {
     return ((value & 0xFF00) >> 8) + ((value & 0x00FF) << 8);
 }
@@ -680,17 +989,24 @@ uint32_t htons32(uint32_t value)
 #define ntohs32 htons32
 
 // Determines whether packet is IP datagram
-bool etherIsIp(uint8_t packet[])
+// size is the number of bytes received, the header must fit in it and the
+// total length must fit in it and cover the header
+RAMFUNC bool etherIsIp(uint8_t packet[], uint16_t size)
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
+    uint8_t ipHeaderSize = (ip->revSize & 0xF) * 4;
     bool ok;
-    ok = (ether->frameType == htons(0x0800));
+    ok = (ether->frameType == htons(0x0800))
+         && ipHeaderSize >= 20 && 14 + ipHeaderSize <= size
+         && ipHeaderSize <= ntohs(ip->length) && 14 + ntohs(ip->length) <= size;
     if (ok)
     {
         sum = 0;
         etherSumWords(&ip->revSize, (ip->revSize & 0xF) * 4);
         ok = (getEtherChecksum() == 0);
+        if (!ok)
+            netStats.ipChecksumErrors++;
     }
     return ok;
 }
@@ -705,7 +1021,6 @@ bool isEtherConnectACK(uint8_t packet[])
 
     bool ok;
     ok = ( mqtt->control == 0x20);
-    if(ok){payload = 4;}
 
     return ok;
 }
@@ -745,7 +1060,6 @@ bool isEtherSubACK(uint8_t packet[])
 
     bool ok;
     ok = ( mqtt->control == 0x90);
-    if(ok){payload=5;}
     return ok;
 }
 
@@ -789,7 +1103,7 @@ bool isEtherFINACK(uint8_t packet[])
 
 // Determines whether packet is unicast to this ip
 // Must be an IP packet
-bool etherIsIpUnicast(uint8_t packet[])
+RAMFUNC bool etherIsIpUnicast(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
@@ -805,7 +1119,7 @@ bool etherIsIpUnicast(uint8_t packet[])
 
 // Determines whether packet is ping request
 // Must be an IP packet
-bool etherIsPingRequest(uint8_t packet[])
+RAMFUNC bool etherIsPingRequest(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
@@ -813,15 +1127,25 @@ bool etherIsPingRequest(uint8_t packet[])
     return (ip->protocol == 0x01 && icmp->type == 8);
 }
 
-// Sends a ping response given the request data
-void etherSendPingResponse(uint8_t packet[])
+// Sends a ping response given the request, reusing its buffer
+// Takes ownership of the frame
+void etherSendPingResponse(pbuf* frame)
 {
-    etherFrame* ether = (etherFrame*)packet;
+    etherFrame* ether = (etherFrame*)frame->data;
     ipFrame* ip = (ipFrame*)&ether->data;
     icmpFrame* icmp = (icmpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
+    uint16_t* typeCode = (uint16_t*)&icmp->type;
+    uint16_t oldTypeCode;
+    uint16_t size = 14 + ntohs(ip->length);
     uint8_t i, tmp;
-    uint16_t icmp_size;
+    // the ip length comes from the sender, never echo more than was received
+    if (size > frame->size)
+    {
+        pbufFree(frame);
+        return;
+    }
     // swap source and destination fields
+    // (swapping leaves the ip header checksum unchanged)
     for (i = 0; i < HW_ADD_LENGTH; i++)
     {
         tmp = ether->destAddress[i];
@@ -835,20 +1159,18 @@ void etherSendPingResponse(uint8_t packet[])
         ip->sourceIp[i] = tmp;
     }
     // this is a response
+    // only the type changes, so update the icmp checksum instead of summing the payload
+    oldTypeCode = *typeCode;
     icmp->type = 0;
-    // calc icmp checksum
-    sum = 0;
-    etherSumWords(&icmp->type, 2);
-    icmp_size = ntohs(ip->length);
-    icmp_size -= 24; // sub ip header and icmp code, type, and check
-    etherSumWords(&icmp->id, icmp_size);
-    icmp->check = getEtherChecksum();
+    icmp->check = etherUpdateChecksum16(icmp->check, oldTypeCode, *typeCode);
+    netStats.icmpRx++;
     // send packet
-    etherPutPacket(ether, 14 + ntohs(ip->length));
+    frame->size = size;
+    etherQueueFrame(frame);
 }
 
 // Determines whether packet is ARP
-bool etherIsArpRequest(uint8_t packet[])
+RAMFUNC bool etherIsArpRequest(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     arpFrame* arp = (arpFrame*)&ether->data;
@@ -865,12 +1187,17 @@ bool etherIsArpRequest(uint8_t packet[])
     return ok;
 }
 
-// Sends an ARP response given the request data
-void etherSendArpResponse(uint8_t packet[])
+// Sends an ARP response given the request, reusing its buffer
+// Takes ownership of the frame
+void etherSendArpResponse(pbuf* frame)
 {
-    etherFrame* ether = (etherFrame*)packet;
+    etherFrame* ether = (etherFrame*)frame->data;
     arpFrame* arp = (arpFrame*)&ether->data;
     uint8_t i, tmp;
+    // the requester is about to talk to us, so cache its address
+    arpUpdate(arp->sourceIp, arp->sourceAddress);
+    netStats.arpRx++;
+    netStats.arpTx++;
     // set op to response
     arp->op = htons(2);
     // swap source and destination fields
@@ -887,7 +1214,35 @@ void etherSendArpResponse(uint8_t packet[])
         arp->sourceIp[i] = tmp;
     }
     // send packet
-    etherPutPacket(ether, 42);
+    frame->size = 42;
+    etherQueueFrame(frame);
+}
+
+// Determines whether packet is an ARP response to this ip
+RAMFUNC bool etherIsArpResponse(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    arpFrame* arp = (arpFrame*)&ether->data;
+    bool ok;
+    uint8_t i = 0;
+    ok = (ether->frameType == htons(0x0806));
+    while (ok && (i < IP_ADD_LENGTH))
+    {
+        ok = (arp->destIp[i] == ipAddress[i]);
+        i++;
+    }
+    if (ok)
+        ok = (arp->op == htons(2));
+    return ok;
+}
+
+// Adds the sender of an ARP response to the arp cache
+void etherProcessArpResponse(uint8_t packet[])
+{
+    etherFrame* ether = (etherFrame*)packet;
+    arpFrame* arp = (arpFrame*)&ether->data;
+    arpUpdate(arp->sourceIp, arp->sourceAddress);
+    netStats.arpRx++;
 }
 
 // Sends an ARP request
@@ -919,20 +1274,26 @@ void etherSendArpRequest(uint8_t packet[], uint8_t ip[])
         arp->sourceIp[i] = ipAddress[i];
         arp->destIp[i] = ip[i];
     }
+    netStats.arpTx++;
     // send packet
-    etherPutPacket(ether, 42);
+    etherPutPacket((uint8_t*)ether, 42);
 }
 
 // Determines whether packet is UDP datagram
 // Must be an IP packet
-bool etherIsUdp(uint8_t packet[])
+RAMFUNC bool etherIsUdp(uint8_t packet[], uint16_t size)
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
-    udpFrame* udp = (udpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
+    uint8_t ipHeaderSize = (ip->revSize & 0xF) * 4;
+    udpFrame* udp = (udpFrame*)((uint8_t*)ip + ipHeaderSize);
     bool ok;
     uint16_t tmp16;
-    ok = (ip->protocol == 0x11);
+    // lengths come from the sender, only sum what was received
+    ok = (ip->protocol == 0x11)
+         && ipHeaderSize <= ntohs(ip->length) && 14 + ntohs(ip->length) <= size
+         && ipHeaderSize + 8 <= ntohs(ip->length)
+         && ntohs(udp->length) >= 8 && ntohs(udp->length) <= ntohs(ip->length) - ipHeaderSize;
     if (ok)
     {
         // 32-bit sum over pseudo-header
@@ -944,6 +1305,10 @@ bool etherIsUdp(uint8_t packet[])
         // add udp header and data
         etherSumWords(udp, ntohs(udp->length));
         ok = (getEtherChecksum() == 0);
+        if (ok)
+            netStats.udpRx++;
+        else
+            netStats.udpChecksumErrors++;
     }
     return ok;
 }
@@ -987,12 +1352,10 @@ void etherSendUdpResponse(uint8_t packet[], uint8_t* udpData, uint8_t udpSize)
     // and rx port on other machine
     udp->sourcePort = udp->destPort;
     // adjust lengths
+    // the address swap leaves the ip checksum unchanged, so only the length is updated
+    tmp16 = ip->length;
     ip->length = htons(((ip->revSize & 0xF) * 4) + 8 + udpSize);
-    // 32-bit sum over ip header
-    sum = 0;
-    etherSumWords(&ip->revSize, 10);
-    etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-    ip->headerChecksum = getEtherChecksum();
+    ip->headerChecksum = etherUpdateChecksum16(ip->headerChecksum, tmp16, ip->length);
     udp->length = htons(8 + udpSize);
     // copy data
     copyData = &udp->data;
@@ -1010,7 +1373,7 @@ void etherSendUdpResponse(uint8_t packet[], uint8_t* udpData, uint8_t udpSize)
     udp->check = getEtherChecksum();
 
     // send packet with size = ether + udp hdr + ip header + udp_size
-    etherPutPacket(ether, 22 + ((ip->revSize & 0xF) * 4) + udpSize);
+    etherPutPacket((uint8_t*)ether, 22 + ((ip->revSize & 0xF) * 4) + udpSize);
 }
 
 uint16_t etherGetId()
@@ -1027,11 +1390,15 @@ void etherIncId()
 void etherEnableDhcpMode()
 {
     dhcpEnabled = true;
+    if (autoFilters)
+        etherUpdateFilters();
 }
 
 void etherDisableDhcpMode()
 {
     dhcpEnabled = false;
+    if (autoFilters)
+        etherUpdateFilters();
 }
 
 bool etherIsDhcpEnabled()
@@ -1051,6 +1418,8 @@ void etherSetIpAddress(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3)
     ipAddress[1] = ip1;
     ipAddress[2] = ip2;
     ipAddress[3] = ip3;
+    if (autoFilters)
+        etherUpdateFilters();
 }
 
 // Gets IP address
@@ -1095,6 +1464,35 @@ void etherGetIpGatewayAddress(uint8_t ip[4])
         ip[i] = ipGwAddress[i];
 }
 
+// Gets the next-hop address for ip
+// Destinations off the local subnet are routed through the gateway
+void etherGetNextHop(const uint8_t ip[4], uint8_t nextHop[4])
+{
+    uint8_t i;
+    bool local = true;
+    for (i = 0; i < IP_ADD_LENGTH; i++)
+        local = local && ((ip[i] & ipSubnetMask[i]) == (ipAddress[i] & ipSubnetMask[i]));
+    for (i = 0; i < IP_ADD_LENGTH; i++)
+        nextHop[i] = local ? ip[i] : ipGwAddress[i];
+}
+
+// Sets MQTT broker address
+void etherSetMqttBrokerAddress(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3)
+{
+    mqttBrokerIp[0] = ip0;
+    mqttBrokerIp[1] = ip1;
+    mqttBrokerIp[2] = ip2;
+    mqttBrokerIp[3] = ip3;
+}
+
+// Gets MQTT broker address
+void etherGetMqttBrokerAddress(uint8_t ip[4])
+{
+    uint8_t i;
+    for (i = 0; i < 4; i++)
+        ip[i] = mqttBrokerIp[i];
+}
+
 // Sets MAC address
 void etherSetMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3, uint8_t mac4, uint8_t mac5)
 {
@@ -1114,734 +1512,597 @@ void etherGetMacAddress(uint8_t mac[6])
         mac[i] = macAddress[i];
 }
 
-bool etherIsTcp(uint8_t packet[])
+// Sets the receive filters (ETHER_ flags), crc is always checked
+// In OR mode a frame is kept if any enabled filter accepts it, with
+// ETHER_ANDOR only if all of them do
+void etherSetReceiveFilters(uint8_t filters)
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-  //  tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    bool ok;
-   // uint16_t tmp16;
-    ok = (ip->protocol == 0x6);
-    if (ok)
+    etherSetBank(ERXFCON);
+    etherWriteReg(ERXFCON, filters | ETHER_CHECKCRC);
+}
+
+// Programs the pattern match filter from a template frame
+// mask selects bytes of the 64 byte window starting at offset; a frame
+// matches when the checksum over its selected bytes equals the template's
+void etherSetPatternMatch(const uint8_t frame[], uint16_t offset, const uint8_t mask[8])
+{
+    uint16_t check;
+    bool odd = false;
+    uint8_t i;
+    // selected bytes are summed as one stream, the first one high
+    sum = 0;
+    for (i = 0; i < 64; i++)
+    {
+        if ((mask[i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        if (odd)
+            sum += frame[offset + i];
+        else
+            sum += frame[offset + i] << 8;
+        odd = !odd;
+    }
+    check = getEtherChecksum();
+    etherSetBank(EPMM0);
+    for (i = 0; i < 8; i++)
+        etherWriteReg(EPMM0 + i, mask[i]);
+    etherWriteReg(EPMCSL, LOBYTE(check));
+    etherWriteReg(EPMCSH, HIBYTE(check));
+    etherWriteReg(EPMOL, LOBYTE(offset));
+    etherWriteReg(EPMOH, HIBYTE(offset));
+}
+
+// Hash table bit for a destination address, bits 28:23 of its crc
+// The crc register is shifted msb first with each byte fed lsb first and is
+// not inverted, as in Microchip's SetRXHashTableEntry (this is not the fcs)
+uint8_t etherGetHashIndex(const uint8_t mac[6])
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint8_t i, j, data;
+    for (i = 0; i < HW_ADD_LENGTH; i++)
     {
-      // make sure that the checksum is correct here
+        data = mac[i];
+        for (j = 0; j < 8; j++)
+        {
+            crc = (crc << 1) ^ (0x04C11DB7 & -((crc >> 31) ^ (data & 1)));
+            data >>= 1;
+        }
     }
-    return ok;
+    return (crc >> 23) & 0x3F;
 }
 
-void sendSyn(uint8_t packet[])
+void etherSetHashTable(const uint8_t table[8])
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-
+    uint8_t i;
+    etherSetBank(EHT0);
+    for (i = 0; i < 8; i++)
+        etherWriteReg(EHT0 + i, table[i]);
+}
 
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
+// Receives frames sent to a multicast address (through the hash table)
+// Returns false if ETHER_MULTICAST_GROUPS are already joined
+bool etherJoinMulticast(const uint8_t mac[6])
+{
+    uint8_t i;
+    for (i = 0; i < multicastCount; i++)
+        if (memcmp(multicastGroups[i], mac, HW_ADD_LENGTH) == 0)
+            return true;
+    if (multicastCount == ETHER_MULTICAST_GROUPS)
+        return false;
+    memcpy(multicastGroups[multicastCount++], mac, HW_ADD_LENGTH);
+    if (autoFilters)
+        etherUpdateFilters();
+    return true;
+}
 
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
+void etherLeaveMulticast(const uint8_t mac[6])
+{
+    uint8_t i;
+    for (i = 0; i < multicastCount; i++)
+    {
+        if (memcmp(multicastGroups[i], mac, HW_ADD_LENGTH) == 0)
+        {
+            memcpy(multicastGroups[i], multicastGroups[--multicastCount], HW_ADD_LENGTH);
+            if (autoFilters)
+                etherUpdateFilters();
+            return;
+        }
+    }
+}
 
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
+// Pattern for arp requests for our ip, window at offset 0: broadcast
+// destination (bytes 0-5), type 0x0806 (12-13), op 1 (20-21), target ip (38-41)
+const uint8_t arpRequestMask[8] = {0x3F, 0x30, 0x30, 0x00, 0xC0, 0x03, 0x00, 0x00};
 
-    //Version
-    ip->revSize = 0x45;
+// Sets the filters to what the stack needs now, so other traffic is
+// dropped by the controller before it costs spi time:
+// - unicast to our mac
+// - arp requests for our ip (pattern match) instead of all broadcasts
+// - joined multicast groups (hash table)
+// - all broadcasts while dhcp is enabled, as offers and acks may be broadcast
+// Called again whenever the ip, dhcp mode or groups change
+void etherUpdateFilters()
+{
+    uint32_t data[11];          // 44 bytes, aligned for the header structures
+    etherFrame* ether = (etherFrame*)data;
+    arpFrame* arp = (arpFrame*)&ether->data;
+    uint8_t table[8];
+    uint8_t filters = ETHER_UNICAST | ETHER_PATTERNMATCH;
+    uint8_t i, hash;
 
-    // Services Field
-    ip->typeOfService = 0x00;
+    memset(data, 0, sizeof(data));
+    memset(ether->destAddress, 0xFF, HW_ADD_LENGTH);
+    ether->frameType = htons(0x0806);
+    arp->op = htons(1);
+    memcpy(arp->destIp, ipAddress, IP_ADD_LENGTH);
+    etherSetPatternMatch((uint8_t*)data, 0, arpRequestMask);
 
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
+    memset(table, 0, sizeof(table));
+    for (i = 0; i < multicastCount; i++)
+    {
+        hash = etherGetHashIndex(multicastGroups[i]);
+        table[hash / 8] |= 1 << (hash % 8);
+    }
+    etherSetHashTable(table);
+    if (multicastCount > 0)
+        filters |= ETHER_HASHTABLE;
 
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
+    if (dhcpEnabled)
+        filters |= ETHER_BROADCAST;
+    etherSetReceiveFilters(filters);
+}
 
-    ip->id = 0x0000;
+RAMFUNC bool etherIsTcp(uint8_t packet[], uint16_t size)
+{
+    etherFrame* ether = (etherFrame*)packet;
+    ipFrame* ip = (ipFrame*)&ether->data;
+    uint8_t ipHeaderSize = (ip->revSize & 0xF) * 4;
+    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ipHeaderSize);
+    bool ok;
+    uint16_t tmp16;
+    // lengths come from the sender, only sum what was received
+    ok = (ip->protocol == 0x6)
+         && ipHeaderSize + 20 <= ntohs(ip->length) && 14 + ntohs(ip->length) <= size;
+    if (ok)
+    {
+        // 32-bit sum over pseudo-header
+        sum = 0;
+        etherSumWords(ip->sourceIp, 8);
+        tmp16 = ip->protocol;
+        sum += (tmp16 & 0xff) << 8;
+        tmp16 = htons(ntohs(ip->length) - ipHeaderSize);
+        etherSumWords(&tmp16, 2);
+        // add tcp header and data
+        etherSumWords(tcp, ntohs(ip->length) - ipHeaderSize);
+        ok = (getEtherChecksum() == 0);
+        if (ok)
+            netStats.tcpRx++;
+        else
+            netStats.tcpChecksumErrors++;
+    }
+    return ok;
+}
 
-    ip->flagsAndOffset = htons(0x4000);
+// Builds the header template for the mqtt connection
+// Everything that stays constant for the life of the connection is written
+// once here, and the constant part of both checksums is summed up front
+void etherInitTcpTemplate()
+{
+    etherFrame* ether = (etherFrame*)tcpConnection.header;
+    ipFrame* ip = (ipFrame*)&ether->data;
+    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + 20);
+    uint8_t i;
+    uint16_t tmp16;
 
-    ip->ttl = 0x80; // or 128 in decimal
+    // destination mac is filled from the arp cache on each send
+    for (i = 0; i < HW_ADD_LENGTH; i++)
+    {
+        ether->sourceAddress[i] = macAddress[i];
+        ether->destAddress[i] = 0;
+    }
+    ether->frameType = htons(0x0800);
 
-    ip->protocol = 0x06; //tcp
+    ip->revSize = 0x45;
+    ip->typeOfService = 0;
+    ip->length = 0;
+    ip->id = 0;
+    ip->flagsAndOffset = htons(0x4000);
+    ip->ttl = 128;
+    ip->protocol = 0x06;
+    ip->headerChecksum = 0;
+    for (i = 0; i < IP_ADD_LENGTH; i++)
+    {
+        ip->sourceIp[i] = ipAddress[i];
+        ip->destIp[i] = mqttBrokerIp[i];
+    }
 
     portNum = (rand() % (49151 - 1024 + 1)) + 1024;
-
     tcp->sourcePort = htons(portNum);
-
-    tcp->destPort = htons(1883);
-
-    tcp->seqNum = 0x0000;
-
-    tcp->ackNum = 0x0000;
-
-    uint8_t dataOff =  (20+4)/4; // 20 Bytes header + 4 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x002; // SYN
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
+    tcp->destPort = htons(MQTT_PORT);
+    tcp->seqNum = 0;
+    tcp->ackNum = 0;
+    tcp->dataResFlags = 0;
+    tcp->winSize = htons(TCP_WINDOW_SIZE);
+    tcp->check = 0;
     tcp->urgPointer = 0;
-    tcp->data=2; //0;
-    tcp->check=0;
-    tcp->options[0]= 4; //2; //Kind = Maximum Segment Size
-    tcp->options[1]= htons(1280); //4; // Length = 4
-    tcp->options[2]= 0; // htons(1280); // Value = 1460 Bytes
-
-    // calculate Checksum
-    //IP checksum
-    // Total length
-        ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + 4); // 20 bytes header and 4 bytes options
-    // 32-bit sum over ip header
-    sum = 0;
-    etherSumWords(&ip->revSize, 10);
-    etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-    ip->headerChecksum = getEtherChecksum();
 
+    // ip header without length (length and checksum fields are zero)
+    sum = 0;
+    etherSumWords(ip, 20);
+    tcpConnection.ipCheck = getEtherChecksum();
 
-    uint16_t tcpLength = htons(20 + 4);
-    // 32-bit sum over pseudo-header
+    // pseudo-header and tcp header without length, seq, ack and flags
     sum = 0;
     etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
+    tmp16 = ip->protocol;
     sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+4);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + 4);
-
-
-}
-
-void sendAck(uint8_t packet[])
-{
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // Total length
-    ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + 0); // 20 bytes header and 0 bytes options
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    // 32-bit sum over ip header
-    sum = 0;
-    etherSumWords(&ip->revSize, 10);
-    etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-    ip->headerChecksum = getEtherChecksum();
-
-    tcp->sourcePort = tcp->destPort;
-
-    tcp->destPort = htons(1883);
-
-    uint32_t ackNum = tcp->ackNum;
-    uint32_t seqNum = tcp->seqNum;
-
-    tcp->ackNum = seqNum;
-    tcp->seqNum = ackNum;
-
-    tcp->ackNum = tcp->ackNum + htons32(payload);
-
-    payload = 1;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0010; // ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-
-    // calculate Checksum
-
-    uint16_t tcpLength = htons(20 + 0);
-    // 32-bit sum over pseudo-header
-    sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+0);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + 0);
+    etherSumWords(tcp, 20);
+    tcpConnection.tcpCheck = getEtherChecksum();
+
+    etherGetNextHop(mqttBrokerIp, tcpConnection.nextHop);
+    tcpConnection.mss = tcpMss;
+    tcpConnection.seqNum = 0;
+    tcpConnection.ackNum = 0;
+}
+
+// Sends a segment on the mqtt connection from the header template
+// Only length, seq/ack, flags and checksums are patched; the data chunks are
+// streamed to the controller and summed in the same pass
+// SYN segments carry the MSS option
+bool etherSendTcp(uint16_t flags, const etherChunk chunks[], uint8_t count)
+{
+    ipFrame* ip = (ipFrame*)&tcpConnection.header[14];
+    tcpFrame* tcp = (tcpFrame*)&tcpConnection.header[34];
+    uint8_t options[4] = {2, 4, HIBYTE(TCP_MSS), LOBYTE(TCP_MSS)};
+    uint8_t optionSize = 0;
+    uint16_t dataSize = 0;
+    uint16_t tcpSize, tcpLength, check, size;
+    pbuf* frame;
+    uint8_t i;
+    bool ok;
+    PERF_BEGIN(PERF_ETHER_SEND_TCP);
 
+    if (flags & TCP_SYN)
+        optionSize = 4;
+    for (i = 0; i < count; i++)
+        dataSize += chunks[i].size;
+    tcpSize = 20 + optionSize + dataSize;
+    ok = dataSize <= tcpConnection.mss && (14 + 20 + tcpSize) <= MAX_TX_FRAME_SIZE;
 
+    if (ok)
+    {
+        // ip length and checksum
+        ip->length = htons(20 + tcpSize);
+        ip->headerChecksum = etherUpdateChecksum16(tcpConnection.ipCheck, 0, ip->length);
+
+        // tcp seq, ack, data offset and flags
+        tcp->seqNum = htons32(tcpConnection.seqNum);
+        tcp->ackNum = htons32(tcpConnection.ackNum);
+        tcp->dataResFlags = htons(((20 + optionSize) << 10) | flags);
+        tcpLength = htons(tcpSize);
+        check = etherUpdateChecksum16(tcpConnection.tcpCheck, 0, tcpLength);
+        check = etherUpdateChecksum16(check, 0, tcp->dataResFlags);
+        check = etherUpdateChecksum32(check, 0, tcp->seqNum);
+        check = etherUpdateChecksum32(check, 0, tcp->ackNum);
+
+        // options and data are summed on top of the header
+        sum = (uint16_t)~check;
+
+        // next-hop mac comes from the arp cache
+        if (arpLookup(tcpConnection.nextHop, tcpConnection.header))
+        {
+            // stream to the controller, summing in the same pass
+            etherTxStart();
+            etherTxWrite(tcpConnection.header, sizeof(tcpConnection.header));
+            etherTxWriteSum(options, optionSize);
+            for (i = 0; i < count; i++)
+                etherTxWriteSum(chunks[i].data, chunks[i].size);
+
+            // patch tcp checksum now that the data has been summed
+            tcp->check = getEtherChecksum();
+            etherTxWriteAt(14 + 20 + 16, (uint8_t*)&tcp->check, 2);
+            etherTxSend(14 + 20 + tcpSize);
+        }
+        else
+        {
+            // still resolving, so build the frame in a buffer that waits for the reply
+            frame = pbufAlloc(14 + 20 + tcpSize);
+            ok = frame != NULL;
+            if (ok)
+            {
+                memcpy(frame->data, tcpConnection.header, sizeof(tcpConnection.header));
+                size = sizeof(tcpConnection.header);
+                memcpy(&frame->data[size], options, optionSize);
+                size += optionSize;
+                for (i = 0; i < count; i++)
+                {
+                    memcpy(&frame->data[size], chunks[i].data, chunks[i].size);
+                    size += chunks[i].size;
+                }
+                etherSumWords(&frame->data[sizeof(tcpConnection.header)], optionSize + dataSize);
+                tcp->check = getEtherChecksum();
+                memcpy(&frame->data[14 + 20 + 16], &tcp->check, 2);
+                frame->size = size;
+                ok = arpQueueFrame(tcpConnection.nextHop, frame);
+                if (!ok)
+                    pbufFree(frame);
+            }
+            if (!ok)
+                netStats.arpQueueDrops++;
+        }
+        tcp->check = 0;
+    }
+    PERF_END(PERF_ETHER_SEND_TCP);
+    if (ok)
+    {
+        netStats.tcpTx++;
+        if (dataSize > 0)
+            netStats.mqttTx++;
+        tcpConnection.seqNum += dataSize;
+        if (flags & (TCP_SYN | TCP_FIN))
+            tcpConnection.seqNum++;
+    }
+    return ok;
 }
 
-
-void sendConnectCmd(uint8_t packet[])
+// Determines whether a tcp segment belongs to the mqtt connection
+// Must be a tcp packet
+bool etherIsTcpConnection(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
     tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttFrame* mqtt = (mqttFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->destPort = tcp->destPort;
-
-    tcp->sourcePort = tcp->sourcePort;
-
-    uint32_t ackNum = tcp->ackNum;
-    uint32_t seqNum = tcp->seqNum;
-
-    tcp->ackNum = ackNum;
-    tcp->seqNum = seqNum;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0018; // PSH ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-
-    mqtt->control = 0x10;
-
-    mqtt->nameLength = htons(4);
-
-    mqtt->name[0] = (uint8_t)'M';
-    mqtt->name[1] = (uint8_t)'Q';
-    mqtt->name[2] = (uint8_t)'T';
-    mqtt->name[3] = (uint8_t)'T';
-
-    mqtt->version = 4;
-
-    mqtt->connectFlag = 0x02;
-
-    mqtt->ttl = htons(60);
-
-    char clientId[50] = "hello";
-
-    strcpy(mqtt->clientId,clientId);
-
-    mqtt->clientIdLength = htons(strlen(mqtt->clientId));
-
-    mqtt->msgLength = 12 + strlen(mqtt->clientId); // 12 Bytes + Client ID array size
-
-    // Total length
-    ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + mqtt->msgLength+2); // 20 IP header + 0 TCP options + 19 MQTT
-
-    // 32-bit sum over ip header
-    sum = 0;
-    etherSumWords(&ip->revSize, 10);
-    etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-    ip->headerChecksum = getEtherChecksum();
-
-    // calculate Checksum
-
-    uint16_t tcpLength = htons(20+mqtt->msgLength+2);
-    // 32-bit sum over pseudo-header
-    sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+mqtt->msgLength+2);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + mqtt->msgLength+2);
-
-
+    return (tcp->destPort == htons(portNum) && tcp->sourcePort == htons(MQTT_PORT));
 }
 
-extern char str2[30];
-extern char str3[30];
-
-void publishMqttMessage(uint8_t packet[])
+// Writes mqtt remaining length using variable length encoding
+// Returns number of bytes written (1 or 2 for the frame sizes supported here)
+uint8_t mqttPutLength(uint8_t buffer[], uint16_t length)
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttPublishFrame* mqtt = (mqttPublishFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->sourcePort = tcp->sourcePort;
-
-    tcp->destPort = htons(1883);
-
-    uint32_t ackNum = tcp->ackNum;
-    uint32_t seqNum = tcp->seqNum;
-
-    tcp->ackNum = ackNum;
-    tcp->seqNum = seqNum;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0018; // PSH ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-
-    mqtt->control = 0x30;
-
-    char topicName[20];
-    char topicMessage[100];
-
-    strcpy(topicName,str2);
-    strcpy(topicMessage,str3);
-
-    strcat( mqtt->topicNameAndMessage, topicName);
-    strcat( mqtt->topicNameAndMessage, topicMessage);
-
-    mqtt->topicLength = htons(strlen(topicName));
-
-    mqtt->msgLength = strlen(mqtt->topicNameAndMessage)+2; //
-
-
-    // Total length
-     ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + mqtt->msgLength+2); // 20 IP header + 0 TCP options + 19 MQTT
-
-     // 32-bit sum over ip header
-     sum = 0;
-     etherSumWords(&ip->revSize, 10);
-     etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-     ip->headerChecksum = getEtherChecksum();
-
-    // calculate TCP Checksum
-
-    uint16_t tcpLength = htons(20+mqtt->msgLength+2);
-    // 32-bit sum over pseudo-header
-    sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+mqtt->msgLength+2);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + mqtt->msgLength+2);
-
-
+    uint8_t size = 0;
+    do
+    {
+        buffer[size] = length & 0x7F;
+        length >>= 7;
+        if (length > 0)
+            buffer[size] |= 0x80;
+        size++;
+    }
+    while (length > 0);
+    return size;
 }
 
-void subscribeRequest(uint8_t packet[])
+// Gets the mss option from a syn segment, limited to our own mss
+// Falls back to the default if it is missing, malformed or zero
+uint16_t etherGetTcpMss(tcpFrame* tcp, uint8_t headerSize)
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttSubReqFrame* mqtt = (mqttSubReqFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->sourcePort = tcp->sourcePort;
-
-    tcp->destPort = tcp->destPort;
-
-    tcp->ackNum = tcp->ackNum;
-    tcp->seqNum = tcp->seqNum;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0018; // PSH ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-
-    mqtt->control = 0x82;
-
-    mqtt->msgID = htons(1);
-
-    strcpy(mqtt->topicName,str2);
-
-    mqtt->topicLength = htons(strlen(mqtt->topicName));
-
-    mqtt->topicName[mqtt->topicLength] = 0; // QoS
-
-    mqtt->msgLength = strlen(str2)+5; //
-
-    // Total length
-     ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + mqtt->msgLength+2); // 20 IP header + 0 TCP options + 19 MQTT
-
-     // 32-bit sum over ip header
-     sum = 0;
-     etherSumWords(&ip->revSize, 10);
-     etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-     ip->headerChecksum = getEtherChecksum();
-
-    // calculate TCP Checksum
-
-    uint16_t tcpLength = htons(20+mqtt->msgLength+2);
-    // 32-bit sum over pseudo-header
-    sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+mqtt->msgLength+2);
+    uint8_t* options = (uint8_t*)tcp + 20;
+    uint8_t size = (headerSize > 20) ? headerSize - 20 : 0;
+    uint8_t i = 0;
+    uint16_t mss = TCP_DEFAULT_MSS;
+    while (i < size && options[i] != 0)
+    {
+        if (options[i] == 1)
+            i++;
+        else
+        {
+            // kind, length and value must all be inside the header
+            if (i + 1 >= size || options[i+1] < 2 || i + options[i+1] > size)
+                break;
+            if (options[i] == 2 && options[i+1] == 4)
+                mss = (options[i+2] << 8) | options[i+3];
+            i += options[i+1];
+        }
+    }
+    if (mss == 0)
+        mss = TCP_DEFAULT_MSS;
+    return (mss < TCP_MSS) ? mss : TCP_MSS;
+}
 
-    tcp->check = getEtherChecksum();
+// Returns the next mqtt packet identifier (never 0)
+uint16_t mqttGetPacketId()
+{
+    mqttPacketId++;
+    if (mqttPacketId == 0)
+        mqttPacketId = 1;
+    return mqttPacketId;
+}
 
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + mqtt->msgLength+2);
+void etherSetMqttKeepAlive(uint16_t seconds)
+{
+    mqttKeepAlive = seconds;
+}
 
+uint16_t etherGetMqttKeepAlive()
+{
+    return mqttKeepAlive;
+}
 
+// Sets the mqtt client id (the string is not copied)
+void etherSetMqttClientId(const char clientId[])
+{
+    mqttClientId = clientId;
 }
 
+void sendSyn()
+{
+    etherInitTcpTemplate();
+    etherSendTcp(TCP_SYN, NULL, 0);
+}
 
-void disconnectRequest(uint8_t packet[])
+// Acknowledges the segment received in packet
+// A segment whose header does not fit in its ip length is dropped unanswered
+void sendAck(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttPublishFrame* mqtt = (mqttPublishFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->sourcePort = tcp->destPort;
-
-    tcp->destPort = htons(1883);
-
-    uint32_t ackNum = tcp->ackNum;
-    uint32_t seqNum = tcp->seqNum;
-
-    tcp->ackNum = seqNum;
-    tcp->seqNum = ackNum ;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0019; // FIN PSH ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-
-    mqtt->control = 0xe0;
-    mqtt->msgLength = 0;
-
-      // Total length
-    ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + 2); // 20 IP header + 0 TCP options + 19 MQTT
-
-     // 32-bit sum over ip header
-     sum = 0;
-     etherSumWords(&ip->revSize, 10);
-     etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-     ip->headerChecksum = getEtherChecksum();
-
-    // calculate TCP Checksum
-
-    uint16_t tcpLength = htons(20+2);
-    // 32-bit sum over pseudo-header
-    sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+2);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + 2);
-
-
-}
-
-extern char str[MAX_CHARS+1];
-
+    uint8_t ipHeaderSize = (ip->revSize & 0xF) * 4;
+    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ipHeaderSize);
+    uint16_t flags = ntohs(tcp->dataResFlags);
+    uint16_t tcpHeaderSize = (flags >> 12) * 4;
+    uint16_t dataSize;
+
+    if (tcpHeaderSize < 20 || ipHeaderSize + tcpHeaderSize > ntohs(ip->length))
+        return;
+    dataSize = ntohs(ip->length) - ipHeaderSize - tcpHeaderSize;
+
+    // data we already acknowledged is a retransmission
+    if (dataSize > 0 && (int32_t)(ntohs32(tcp->seqNum) - tcpConnection.ackNum) < 0)
+        netStats.tcpRetransmitsRx++;
+    tcpConnection.ackNum = ntohs32(tcp->seqNum) + dataSize;
+    if (flags & (TCP_SYN | TCP_FIN))
+        tcpConnection.ackNum++;
+    if (flags & TCP_SYN)
+        tcpConnection.mss = tcpMss = etherGetTcpMss(tcp, tcpHeaderSize);
+    etherSendTcp(TCP_ACK, NULL, 0);
+}
+
+void sendConnectCmd()
+{
+    uint8_t header[14] = {0x10, 0, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 0, 0, 0};
+    etherChunk chunks[2];
+    uint16_t clientIdSize = strlen(mqttClientId);
+
+    header[1] = 12 + clientIdSize;
+    header[10] = HIBYTE(mqttKeepAlive);
+    header[11] = LOBYTE(mqttKeepAlive);
+    header[12] = HIBYTE(clientIdSize);
+    header[13] = LOBYTE(clientIdSize);
+    chunks[0].data = header;
+    chunks[0].size = sizeof(header);
+    chunks[1].data = (const uint8_t*)mqttClientId;
+    chunks[1].size = clientIdSize;
+    etherSendTcp(TCP_PSH | TCP_ACK, chunks, 2);
+}
+
+// Publishes a message on topic (QoS 0)
+// Topic and message are streamed straight into the controller tx buffer
+// while the tcp checksum is summed, so the payload is read exactly once and
+// never copied in MCU RAM
+bool publishMqttMessage(const char topic[], const uint8_t message[], uint16_t messageSize)
+{
+    uint8_t header[5];
+    uint8_t headerSize = 0;
+    uint16_t topicSize = strlen(topic);
+    etherChunk chunks[3];
+
+    header[headerSize++] = 0x30;
+    headerSize += mqttPutLength(&header[headerSize], 2 + topicSize + messageSize);
+    header[headerSize++] = HIBYTE(topicSize);
+    header[headerSize++] = LOBYTE(topicSize);
+    chunks[0].data = header;
+    chunks[0].size = headerSize;
+    chunks[1].data = (const uint8_t*)topic;
+    chunks[1].size = topicSize;
+    chunks[2].data = message;
+    chunks[2].size = messageSize;
+    if (!etherSendTcp(TCP_PSH | TCP_ACK, chunks, 3))
+        return false;
+    netStats.mqttPublishTx++;
+    return true;
+}
+
+void subscribeRequest(const char topic[])
+{
+    uint8_t header[7];
+    uint8_t headerSize = 0;
+    uint8_t qos = 0;
+    uint16_t topicSize = strlen(topic);
+    uint16_t packetId;
+    etherChunk chunks[3];
+
+    header[headerSize++] = 0x82;
+    headerSize += mqttPutLength(&header[headerSize], 2 + 2 + topicSize + 1);
+    packetId = mqttGetPacketId();
+    header[headerSize++] = HIBYTE(packetId);
+    header[headerSize++] = LOBYTE(packetId);
+    header[headerSize++] = HIBYTE(topicSize);
+    header[headerSize++] = LOBYTE(topicSize);
+    chunks[0].data = header;
+    chunks[0].size = headerSize;
+    chunks[1].data = (const uint8_t*)topic;
+    chunks[1].size = topicSize;
+    chunks[2].data = &qos;
+    chunks[2].size = 1;
+    etherSendTcp(TCP_PSH | TCP_ACK, chunks, 3);
+}
+
+void UnSubscribeRequest(const char topic[])
+{
+    uint8_t header[7];
+    uint8_t headerSize = 0;
+    uint16_t topicSize = strlen(topic);
+    uint16_t packetId;
+    etherChunk chunks[2];
+
+    header[headerSize++] = 0xa2;
+    headerSize += mqttPutLength(&header[headerSize], 2 + 2 + topicSize);
+    packetId = mqttGetPacketId();
+    header[headerSize++] = HIBYTE(packetId);
+    header[headerSize++] = LOBYTE(packetId);
+    header[headerSize++] = HIBYTE(topicSize);
+    header[headerSize++] = LOBYTE(topicSize);
+    chunks[0].data = header;
+    chunks[0].size = headerSize;
+    chunks[1].data = (const uint8_t*)topic;
+    chunks[1].size = topicSize;
+    etherSendTcp(TCP_PSH | TCP_ACK, chunks, 2);
+}
+
+void disconnectRequest()
+{
+    const uint8_t header[2] = {0xe0, 0};
+    etherChunk chunk = {header, 2};
+    etherSendTcp(TCP_FIN | TCP_PSH | TCP_ACK, &chunk, 1);
+}
+
+void sendPingRequest()
+{
+    const uint8_t header[2] = {0xc0, 0};
+    etherChunk chunk = {header, 2};
+    netStats.mqttPings++;
+    etherSendTcp(TCP_PSH | TCP_ACK, &chunk, 1);
+}
+
+// Prints the message of a received publish
 void getMqttMessage(uint8_t packet[])
 {
     etherFrame* ether = (etherFrame*)packet;
     ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttPublishFrame* mqtt = (mqttPublishFrame*)&tcp->data;
-
-    uint8_t i; char* topicname;
-
-    for(i=0;i<htons(mqtt->topicLength);i++)
+    uint8_t ipHeaderSize = (ip->revSize & 0xF) * 4;
+    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ipHeaderSize);
+    uint16_t tcpHeaderSize = (ntohs(tcp->dataResFlags) >> 12) * 4;
+    uint16_t dataSize;
+    uint8_t* data = packet + 14 + ipHeaderSize + tcpHeaderSize;
+    uint32_t remaining = 0;
+    uint16_t i = 1;
+    uint16_t topicSize;
+
+    if (tcpHeaderSize < 20 || ipHeaderSize + tcpHeaderSize > ntohs(ip->length))
+        return;
+    dataSize = ntohs(ip->length) - ipHeaderSize - tcpHeaderSize;
+    // remaining length is 7 bits per byte, low group first (see mqttPutLength)
+    do
     {
-        topicname[i] = mqtt->topicNameAndMessage[i];
-    }
-
-    topicname[i+1] = 0;
-
-    if (tcp->check != checksum ) //& strcmp(topicname,str2)
+        if (i > 4 || i >= dataSize)
+            return;
+        remaining |= (uint32_t)(data[i] & 0x7F) << (7 * (i - 1));
+    } while (data[i++] & 0x80);
+    // the topic length and topic must fit in the message, the message in the segment
+    if (dataSize < i + 2)
+        return;
+    topicSize = (data[i] << 8) | data[i + 1];
+    if (topicSize + 2 > remaining || remaining > dataSize - i)
+        return;
+
+    // a retransmission has the same checksum, print it once
+    if (tcp->check != checksum)
     {
         checksum = tcp->check;
-        i = 0;
-
-        for (i=0;i<10;i++)
-            str[i]=0;
-
-        uint8_t j =0;
-
-        for (i=htons(mqtt->topicLength);i<mqtt->msgLength-2;i++)
-        {
-        str[j++] = mqtt->topicNameAndMessage[i];
-        }
-        str[j] = 0;
-        putsUart0(str);
-        putsUart0("\n\r");
-
-        payload = mqtt->msgLength+2;
+        netStats.mqttPublishRx++;
+        // written straight from the packet; dropped rather than stall if the console is backed up
+        writeUart0((char*)&data[i + 2 + topicSize], remaining - 2 - topicSize, UART0_DROP);
+        putsUart0NoWait("\n\r");
     }
-
 }
 
 bool isEtherMqttPingResponse(uint8_t packet[])
@@ -1853,7 +2114,6 @@ bool isEtherMqttPingResponse(uint8_t packet[])
 
     bool ok;
     ok = ( mqtt->control == 0xd0);
-    if(ok){payload=2;}
     return ok;
 }
 
@@ -1866,244 +2126,89 @@ bool isEtherUnSubACK(uint8_t packet[])
 
     bool ok;
     ok = ( mqtt->control == 0xb0);
-    if(ok){payload=4;}
     return ok;
 }
 
-void sendPingRequest(uint8_t packet[])
+// Saves the current next hop mac and session parameters for the next boot
+// Only words that changed are written to limit eeprom wear
+void etherSaveWarmStart()
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttPublishFrame* mqtt = (mqttPublishFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->sourcePort = htons(portNum);
-
-    tcp->destPort = tcp->destPort;
-
-    tcp->ackNum = tcp->ackNum;
-
-    tcp->seqNum = tcp->seqNum;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-
-    uint8_t res = 0;
-
-    uint16_t flags = 0x0018; // PSH ACK
-
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-
-    tcp->data=0;
-
-    tcp->check=0;
-
-    mqtt->control = 0xc0;
-    mqtt->msgLength = 0;
-
-    // Total length
-    ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + 2); // 20 IP header + 0 TCP options + 19 MQTT
-
-    // 32-bit sum over ip header
-     sum = 0;
-     etherSumWords(&ip->revSize, 10);
-     etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-     ip->headerChecksum = getEtherChecksum();
-
-    // calculate TCP Checksum
-
-    uint16_t tcpLength = htons(20+2);
-
-    // 32-bit sum over pseudo-header
-   sum = 0;
-
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-    etherSumWords(tcp, 20+2);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + 2);
-
-}
-
-void initEeprom()
-{
-    SYSCTL_RCGCEEPROM_R = 1;
-    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
-}
-
-void writeEeprom(uint16_t add, uint32_t eedata)
-{
-    EEPROM_EEBLOCK_R = add >> 4;
-    EEPROM_EEOFFSET_R = add & 0xF;
-    EEPROM_EERDWR_R = eedata;
-    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
-}
-
-uint32_t readEeprom(uint16_t add)
-{
-    EEPROM_EEBLOCK_R = add >> 4;
-    EEPROM_EEOFFSET_R = add & 0xF;
-    return EEPROM_EERDWR_R;
+    warmStartRecord record;
+    uint8_t i;
+    memset(&record, 0, sizeof(record));
+    if (!arpLookup(tcpConnection.nextHop, record.fields.mac))
+        return;
+    record.fields.magic = WARM_START_MAGIC;
+    memcpy(record.fields.nextHop, tcpConnection.nextHop, 4);
+    record.fields.mss = tcpMss;
+    record.fields.keepAlive = mqttKeepAlive;
+    record.fields.packetId = mqttPacketId;
+    sum = 0;
+    etherSumWords(&record, sizeof(record) - 2);
+    record.fields.checksum = getEtherChecksum();
+    for (i = 0; i < 6; i++)
+    {
+        if (readEeprom(WARM_START_ADDRESS + i) != record.words[i])
+            writeEeprom(WARM_START_ADDRESS + i, record.words[i]);
+    }
 }
 
-void UnSubscribeRequest(uint8_t packet[])
+// Restores the warm start record, priming the arp cache and mqtt client
+// Returns false (cold start) if the record is missing, corrupt or the
+// route to the broker has changed since it was saved
+// Call after the ip address, subnet mask and gateway are set
+bool etherLoadWarmStart()
 {
-    etherFrame* ether = (etherFrame*)packet;
-    ipFrame* ip = (ipFrame*)&ether->data;
-    tcpFrame* tcp = (tcpFrame*)((uint8_t*)ip + ((ip->revSize & 0xF) * 4));
-    mqttUnSubReqFrame* mqtt = (mqttUnSubReqFrame*)&tcp->data;
-
-    // MAC address of the red board
-    ether->sourceAddress[0] = 0x02;
-    ether->sourceAddress[1] = 0x03;
-    ether->sourceAddress[2] = 0x04;
-    ether->sourceAddress[3] = 0x05;
-    ether->sourceAddress[4] = 0x06;
-    ether->sourceAddress[5] = 0x07;
-
-    // MAC address of the Linux PC
-    ether->destAddress[0] = 0x1c;
-    ether->destAddress[1] = 0x69;
-    ether->destAddress[2] = 0x7a;
-    ether->destAddress[3] = 0x07;
-    ether->destAddress[4] = 0x94;
-    ether->destAddress[5] = 0xe3;
-
-    // Frame Type is IP
-    ether->frameType = htons(0x0800);
-
-    //Version
-    ip->revSize = 0x45;
-
-    // Services Field
-    ip->typeOfService = 0x00;
-
-    // IP address of the source
-    ip->sourceIp[0] = ipAddress[0];
-    ip->sourceIp[1] = ipAddress[1];
-    ip->sourceIp[2] = ipAddress[2];
-    ip->sourceIp[3] = ipAddress[3];
-
-    // IP address of the destination
-    ip->destIp[0] = 192;
-    ip->destIp[1] = 168;
-    ip->destIp[2] = 10;
-    ip->destIp[3] = 2;
-
-    ip->id = 0x0000;
-
-    ip->flagsAndOffset = htons(0x4000);
-
-    ip->ttl = 0x80; // or 128 in decimal
-
-    ip->protocol = 0x06; //tcp
-
-    tcp->sourcePort = htons(portNum);
-
-    tcp->destPort = htons(1883);
-
-    tcp->ackNum = tcp->ackNum;
-    tcp->seqNum = tcp->seqNum;
-
-    uint8_t dataOff =  (20+0)/4; // 20 Bytes header + 0 Bytes options
-    uint8_t res = 0;
-    uint16_t flags = 0x0018; // PSH ACK
-    tcp->dataResFlags = htons( dataOff<<12 | (res>>5)<<9 | flags );
-
-    tcp->winSize = htons(1280);
-
-    tcp->urgPointer = 0;
-    tcp->data=0;
-    tcp->check=0;
-
-    mqtt->control = 0xa2;
-
-    mqtt->msgID = htons(1);
-
-    strcpy(mqtt->topicName,str2);
-
-    mqtt->topicLength = htons(strlen(mqtt->topicName));
-
-    //mqtt->topicName[mqtt->topicLength] = 0; // QoS
-
-    mqtt->msgLength = strlen(str2)+4; //
-
-    // Total length
-     ip->length = htons(((ip->revSize & 0xF) * 4) + 20 + mqtt->msgLength+2); // 20 IP header + 0 TCP options + 19 MQTT
-
-     // 32-bit sum over ip header
-     sum = 0;
-     etherSumWords(&ip->revSize, 10);
-     etherSumWords(ip->sourceIp, ((ip->revSize & 0xF) * 4) - 12);
-     ip->headerChecksum = getEtherChecksum();
-
-    // calculate TCP Checksum
-
-    uint16_t tcpLength = htons(20+mqtt->msgLength+2);
-    // 32-bit sum over pseudo-header
+    warmStartRecord record;
+    uint8_t nextHop[4];
+    readEepromBlock(WARM_START_ADDRESS, record.words, 6);
+    if (record.fields.magic != WARM_START_MAGIC)
+        return false;
     sum = 0;
-    etherSumWords(ip->sourceIp, 8);
-    uint16_t tmp16 = ip->protocol;
-    sum += (tmp16 & 0xff) << 8;
-    etherSumWords(&tcpLength, 2);
-
-    etherSumWords(tcp, 20+mqtt->msgLength+2);
-
-    tcp->check = getEtherChecksum();
-
-    etherPutPacket((uint8_t*)ether, 14 + ((ip->revSize & 0xF) * 4) +  20 + mqtt->msgLength+2);
-
+    etherSumWords(&record, sizeof(record));
+    if (getEtherChecksum() != 0)
+        return false;
+    // records written before the mss was checked can hold 0
+    if (record.fields.mss == 0 || record.fields.mss > TCP_MSS)
+        return false;
+    etherGetNextHop(mqttBrokerIp, nextHop);
+    if (memcmp(nextHop, record.fields.nextHop, 4) != 0)
+        return false;
+    arpPrime(record.fields.nextHop, record.fields.mac);
+    tcpMss = record.fields.mss;
+    mqttKeepAlive = record.fields.keepAlive;
+    mqttPacketId = record.fields.packetId;
+    return true;
+}
+
+void etherResetStats()
+{
+    memset(&netStats, 0, sizeof(netStats));
+}
+
+// Writes the statistics as compact json, for publishing over mqtt
+// Returns the length written, or 0 if buffer is too small
+uint16_t etherFormatStats(char buffer[], uint16_t size)
+{
+    const uint32_t* values = (const uint32_t*)&netStats;
+    uint16_t length = 0;
+    uint16_t nameSize;
+    uint8_t i;
+    for (i = 0; i < ETHER_STAT_COUNT; i++)
+    {
+        nameSize = strlen(etherStatNames[i]);
+        // separator, quoted name, colon, value and closing brace
+        if (length + nameSize + 4 + FORMAT_DECIMAL_SIZE + 1 > size)
+            return 0;
+        buffer[length++] = (i == 0) ? '{' : ',';
+        buffer[length++] = '"';
+        memcpy(&buffer[length], etherStatNames[i], nameSize);
+        length += nameSize;
+        buffer[length++] = '"';
+        buffer[length++] = ':';
+        length += formatDecimal(&buffer[length], values[i]);
+    }
+    buffer[length++] = '}';
+    buffer[length] = 0;
+    return length;
 }
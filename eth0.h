@@ -7,7 +7,7 @@
 
 // Target Platform: EK-TM4C123GXL w/ ENC28J60
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // ENC28J60 Ethernet controller on SPI0
@@ -27,6 +27,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "pbuf.h"
 
 #define ETHER_UNICAST        0x80
 #define ETHER_BROADCAST      0x01
@@ -35,9 +36,53 @@
 #define ETHER_MAGICPACKET    0x08
 #define ETHER_PATTERNMATCH   0x10
 #define ETHER_CHECKCRC       0x20
+#define ETHER_ANDOR          0x40   // all enabled filters must match
 
 #define ETHER_HALFDUPLEX     0x00
 #define ETHER_FULLDUPLEX     0x100
+#define ETHER_AUTOFILTER     0x200  // filters follow the stack (etherUpdateFilters)
+
+// Multicast groups accepted through the hash table
+#define ETHER_MULTICAST_GROUPS 4
+
+typedef struct _etherChunk
+{
+    const uint8_t* data;
+    uint16_t size;
+} etherChunk;
+
+// Network statistics, plain increments on the fast path
+// All fields are uint32_t, in the order of etherStatNames
+typedef struct _etherStats
+{
+    uint32_t rxFrames;
+    uint32_t rxBytes;
+    uint32_t rxOverflows;
+    uint32_t rxTruncated;          // larger than the receive buffer
+    uint32_t txFrames;
+    uint32_t txBytes;
+    uint32_t txErrors;             // aborted by the controller
+    uint32_t ipChecksumErrors;
+    uint32_t tcpChecksumErrors;
+    uint32_t udpChecksumErrors;
+    uint32_t arpRx;
+    uint32_t arpTx;
+    uint32_t arpQueueDrops;        // no room to hold a frame during resolution
+    uint32_t icmpRx;
+    uint32_t tcpRx;
+    uint32_t tcpTx;
+    uint32_t tcpRetransmitsRx;     // segments the peer sent again
+    uint32_t udpRx;
+    uint32_t mqttTx;
+    uint32_t mqttPublishTx;
+    uint32_t mqttPublishRx;
+    uint32_t mqttPings;
+} etherStats;
+
+#define ETHER_STAT_COUNT (sizeof(etherStats) / sizeof(uint32_t))
+
+extern etherStats netStats;
+extern const char* const etherStatNames[];
 
 #define LOBYTE(x) ((x) & 0xFF)
 #define HIBYTE(x) (((x) >> 8) & 0xFF)
@@ -67,22 +112,48 @@ typedef enum
 void etherInit(uint16_t mode);
 bool etherIsLinkUp();
 
+void etherSetReceiveFilters(uint8_t filters);
+void etherSetPatternMatch(const uint8_t frame[], uint16_t offset, const uint8_t mask[8]);
+uint8_t etherGetHashIndex(const uint8_t mac[6]);
+void etherSetHashTable(const uint8_t table[8]);
+bool etherJoinMulticast(const uint8_t mac[6]);
+void etherLeaveMulticast(const uint8_t mac[6]);
+void etherUpdateFilters();
+
 bool etherIsDataAvailable();
+void etherIsr();
+bool etherIsRxPending();
 bool etherIsOverflow();
-uint16_t etherGetPacket(uint8_t packet[], uint16_t maxSize);
-bool etherPutPacket(uint8_t packet[], uint16_t size);
-
-bool etherIsIp(uint8_t packet[]);
+void etherResetStats();
+uint16_t etherFormatStats(char buffer[], uint16_t size);
+pbuf* etherGetFrame();
+void etherPutPacket(uint8_t packet[], uint16_t size);
+void etherTxStart();
+void etherTxWrite(const uint8_t data[], uint16_t size);
+void etherTxWriteSum(const uint8_t data[], uint16_t size);
+void etherTxWriteAt(uint16_t offset, const uint8_t data[], uint16_t size);
+void etherTxSend(uint16_t size);
+bool etherIsTxDone();
+void etherTxComplete();
+void etherTxFlush();
+void etherQueueFrame(pbuf* frame);
+
+uint16_t etherUpdateChecksum16(uint16_t check, uint16_t oldValue, uint16_t newValue);
+uint16_t etherUpdateChecksum32(uint16_t check, uint32_t oldValue, uint32_t newValue);
+
+bool etherIsIp(uint8_t packet[], uint16_t size);
 bool etherIsIpUnicast(uint8_t packet[]);
 
 bool etherIsPingRequest(uint8_t packet[]);
-void etherSendPingResponse(uint8_t packet[]);
+void etherSendPingResponse(pbuf* frame);
 
 bool etherIsArpRequest(uint8_t packet[]);
-void etherSendArpResponse(uint8_t packet[]);
+void etherSendArpResponse(pbuf* frame);
 void etherSendArpRequest(uint8_t packet[], uint8_t ip[]);
+bool etherIsArpResponse(uint8_t packet[]);
+void etherProcessArpResponse(uint8_t packet[]);
 
-bool etherIsUdp(uint8_t packet[]);
+bool etherIsUdp(uint8_t packet[], uint16_t size);
 uint8_t* etherGetUdpData(uint8_t packet[]);
 void etherSendUdpResponse(uint8_t packet[], uint8_t* udpData, uint8_t udpSize);
 
@@ -96,10 +167,16 @@ void etherSetIpGatewayAddress(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3
 void etherGetIpGatewayAddress(uint8_t ip[4]);
 void etherSetIpSubnetMask(uint8_t mask0, uint8_t mask1, uint8_t mask2, uint8_t mask3);
 void etherGetIpSubnetMask(uint8_t mask[4]);
+void etherGetNextHop(const uint8_t ip[4], uint8_t nextHop[4]);
+void etherSetMqttBrokerAddress(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3);
+void etherGetMqttBrokerAddress(uint8_t ip[4]);
 void etherSetMacAddress(uint8_t mac0, uint8_t mac1, uint8_t mac2, uint8_t mac3, uint8_t mac4, uint8_t mac5);
 void etherGetMacAddress(uint8_t mac[6]);
 
-bool etherIsTcp(uint8_t packet[]);
+bool etherIsTcp(uint8_t packet[], uint16_t size);
+bool etherIsTcpConnection(uint8_t packet[]);
+void etherInitTcpTemplate();
+bool etherSendTcp(uint16_t flags, const etherChunk chunks[], uint8_t count);
 bool isEtherSYNACK(uint8_t packet[]);
 bool isEtherConnectACK(uint8_t packet[]);
 bool isEtherACK(uint8_t packet[]);
@@ -110,19 +187,21 @@ bool isEtherMqttPublish(uint8_t packet[]);
 bool isEtherMqttPingResponse(uint8_t packet[]);
 bool isEtherUnSubACK(uint8_t packet[]);
 
-void sendSyn(uint8_t packet[]);
+void sendSyn();
 void sendAck(uint8_t packet[]);
-void sendConnectCmd(uint8_t packet[]);
-void publishMqttMessage(uint8_t packet[]);
-void disconnectRequest(uint8_t packet[]);
-void subscribeRequest(uint8_t packet[]);
+void sendConnectCmd();
+bool publishMqttMessage(const char topic[], const uint8_t message[], uint16_t messageSize);
+void disconnectRequest();
+void subscribeRequest(const char topic[]);
 void getMqttMessage(uint8_t packet[]);
-void sendPingRequest(uint8_t packet[]);
-void initEeprom();
-void writeEeprom(uint16_t add, uint32_t eedata);
-uint32_t readEeprom(uint16_t add);
+void sendPingRequest();
+void etherSetMqttKeepAlive(uint16_t seconds);
+uint16_t etherGetMqttKeepAlive();
+void etherSetMqttClientId(const char clientId[]);
+void etherSaveWarmStart();
+bool etherLoadWarmStart();
 void displayConnectionInfo();
-void UnSubscribeRequest(uint8_t packet[]);
+void UnSubscribeRequest(const char topic[]);
 
 uint16_t htons(uint16_t value);
 #define ntohs htons
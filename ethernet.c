@@ -7,7 +7,7 @@
 
 // Target Platform: EK-TM4C123GXL w/ ENC28J60
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // ENC28J60 Ethernet controller on SPI0
@@ -35,15 +35,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <string.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "eth0.h"
 #include "gpio.h"
 #include "spi0.h"
 #include "uart0.h"
 #include "wait.h"
 #include "shell.h"
+#include "arp.h"
+#include "eeprom.h"
+#include "config.h"
+#include "format.h"
+#include "log.h"
+#include "perf.h"
+#include "timer.h"
+#include "sched.h"
+#include "pt.h"
+#include "pbuf.h"
 
 // Pins
 #define RED_LED PORTF,1
@@ -51,13 +61,29 @@
 #define GREEN_LED PORTF,3
 #define PUSH_BUTTON PORTF,4
 
+// Times in ticks
+#define LED_BLINK_TIME     TIMER_MS(100)
+#define TIME_WAIT_TIME     TIMER_MS(100)
+#define MQTT_REPLY_TIME    TIMER_SECONDS(5)
+#define BUTTON_SAMPLE_TIME TIMER_MS(20)
+
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
 uint8_t publishFlag = 0;
 uint8_t subscribeFlag = 0;
-uint32_t timerCounter = 0;
 uint8_t connectFlag = 0;
+char mqttTopic[MQTT_TOPIC_SIZE];
+char mqttMessage[MQTT_MESSAGE_SIZE];
+uint16_t statsInterval = 0;     // seconds between netstat publishes, 0 is off
+uint16_t statsCounter = 0;
+uint8_t statsFlag = 0;          // current publish carries the statistics
+uint8_t pingFlag = 0;           // keepalive ping is due
+timer secondTimer;
+timer keepaliveTimer;
+timer ledTimer;
+timer buttonTimer;
+bool buttonPressed = false;
 
 //-----------------------------------------------------------------------------
 // Subroutines                
@@ -66,8 +92,8 @@ uint8_t connectFlag = 0;
 // Initialize Hardware
 void initHw()
 {
-	// Configure HW to work with 16 MHz XTAL, PLL enabled, system clock of 40 MHz
-    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | (4 << SYSCTL_RCC_SYSDIV_S);
+    // Configure HW to work with 16 MHz XTAL, PLL enabled, system clock of SYSTEM_CLOCK
+    initClock();
 
     // Enable clocks
     enablePort(PORTF);
@@ -78,141 +104,262 @@ void initHw()
     selectPinPushPullOutput(GREEN_LED);
     selectPinPushPullOutput(BLUE_LED);
     selectPinDigitalInput(PUSH_BUTTON);
+    enablePinPullup(PUSH_BUTTON);
 
-    // Configure Timer 1 as a counter
-    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R1; // Enable clocks
-    TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer before reconfiguring
-    TIMER1_CFG_R = TIMER_CFG_32_BIT_TIMER;           // configure as 32-bit timer (A+B)
-    TIMER1_TAMR_R =  TIMER_TAMR_TACDIR; //  count up // TIMER_TAMR_TAMR_CAP |
-    TIMER1_IMR_R = 0;                                 // turn-off interrupts
-    TIMER1_TAV_R = 0;                               // zero counter for first period
-    TIMER1_CTL_R |= TIMER_CTL_TAEN;                  // turn-on counter
-    NVIC_EN0_R &= ~(1 << (INT_TIMER1A-16));           // turn-off interrupt 37 (TIMER1A)
+    // Configure SysTick as the 1 ms system tick
+    initTimer();
+}
+
+// Publishes the network statistics as json on netstat/<client id>
+void publishStats()
+{
+    char topic[8 + CONFIG_CLIENT_ID_SIZE] = "netstat/";
+    char message[490];
+    uint16_t size = etherFormatStats(message, sizeof(message));
+    strcpy(&topic[8], cfg.fields.clientId);
+    publishMqttMessage(topic, (uint8_t*)message, size);
 }
 
 void displayConnectionInfo()
 {
-    uint8_t i;
-    uint8_t mqttIp[4] = {192,168,10,2};
-    char str[10];
+    uint8_t mqttIp[4];
     uint8_t mac[6];
     uint8_t ip[4];
-    putcUart0('\r');
-   putcUart0('\n');
+    putsUart0("\r\n");
     etherGetMacAddress(mac);
-
     putsUart0("HW MAC: ");
-    for (i = 0; i < 6; i++)
-    {
-        sprintf(str, "%02x", mac[i]);
-        putsUart0(str);
-        if (i < 6-1)
-            putcUart0(':');
-    }
-    putcUart0('\r');
-     putcUart0('\n');
+    putMacUart0(mac);
+    putsUart0("\r\n");
     etherGetIpAddress(ip);
     putsUart0("Client IP: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        putsUart0(str);
-        if (i < 4-1)
-            putcUart0('.');
-    }
+    putIpUart0(ip);
     if (etherIsDhcpEnabled())
         putsUart0(" (dhcp)");
     else
         putsUart0(" (static)");
-    putcUart0('\r');
-    putcUart0('\n');
+    putsUart0("\r\n");
+    etherGetMqttBrokerAddress(mqttIp);
     putsUart0("MQTT IP: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", mqttIp[i]);
-        putsUart0(str);
-        if (i < 4-1)
-            putcUart0('.');
-    }
-    putsUart0(" (fixed)");
-     putcUart0('\r');
-     putcUart0('\n');
+    putIpUart0(mqttIp);
+    putsUart0(" (fixed)\r\n");
     etherGetIpSubnetMask(ip);
     putsUart0("SN: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        putsUart0(str);
-        if (i < 4-1)
-            putcUart0('.');
-    }
-    putcUart0('\r');
-     putcUart0('\n');
+    putIpUart0(ip);
+    putsUart0("\r\n");
     etherGetIpGatewayAddress(ip);
     putsUart0("GW: ");
-    for (i = 0; i < 4; i++)
-    {
-        sprintf(str, "%u", ip[i]);
-        putsUart0(str);
-        if (i < 4-1)
-            putcUart0('.');
-    }
-    putcUart0('\r');
-     putcUart0('\n');
+    putIpUart0(ip);
+    putsUart0("\r\n");
     if (etherIsLinkUp())
         putsUart0("Link is up\n\r");
     else
         putsUart0("Link is down\n\r");
-    putcUart0('\r');
-      putcUart0('\n');
-
+    putsUart0("\r\n");
 }
 
 //-----------------------------------------------------------------------------
 // Main
 //-----------------------------------------------------------------------------
 
-// Max packet is calculated as:
-// Ether frame header (18) + Max MTU (1500) + CRC (4)
-#define MAX_PACKET_SIZE 1522
 TCPState NextState = closed;
+TCPState lastState = closed;
+pt mqttPt;
+timer mqttTimer;                    // reply timeout and TIME_WAIT
+pbuf* mqttFrame = NULL;             // segment lent to the thread for this call
+bool mqttSegment = false;           // mqttFrame not yet consumed
+TCPState mqttThreadState = closed;  // last state set by the thread
 
+// Timer callbacks, run from timerService() in the main loop
 
-int main(void)
+void setFlag(void* context)
 {
-    uint8_t data[MAX_PACKET_SIZE];
+    *(uint8_t*)context = 1;
+}
+
+void redLedOff(void* context)
+{
+    setPinValue(RED_LED, 0);
+}
+
+// 1 second tick for arp aging and the statistics interval
+void secondTick(void* context)
+{
+    arpTick();
+    if (statsInterval != 0 && ++statsCounter >= statsInterval && !schedIsQueued(EVENT_STATS))
+        schedPost(EVENT_STATS, 0);
+}
+
+// Debounced by sampling, posts on the press (the button pulls the pin low)
+void sampleButton(void* context)
+{
+    bool pressed = !getPinValue(PUSH_BUTTON);
+    if (pressed && !buttonPressed)
+        schedPost(EVENT_BUTTON, 0);
+    buttonPressed = pressed;
+}
+
+// Event sources, polled before each dispatch
+// Each posts at most one event of its kind at a time
+
+void rxSource()
+{
+    if (!schedIsQueued(EVENT_RX_FRAME) && etherIsRxPending())
+        schedPost(EVENT_RX_FRAME, 0);
+}
+
+void txSource()
+{
+    if (!schedIsQueued(EVENT_TX_DONE) && etherIsTxDone())
+        schedPost(EVENT_TX_DONE, 0);
+}
+
+void uartSource()
+{
+    if (!schedIsQueued(EVENT_UART_LINE) && shellPoll())
+        schedPost(EVENT_UART_LINE, 0);
+}
+
+void timerSource()
+{
+    if (!schedIsQueued(EVENT_TIMER) && timerIsDue())
+        schedPost(EVENT_TIMER, 0);
+}
+
+// The connection moves on by itself while a request is open
+void mqttSource()
+{
+    if (!schedIsQueued(EVENT_MQTT) && (publishFlag | subscribeFlag | connectFlag))
+        schedPost(EVENT_MQTT, 0);
+}
+
+void logSource()
+{
+    if (!schedIsQueued(EVENT_LOG) && logIsPending())
+        schedPost(EVENT_LOG, 0);
+}
+
+// Event handlers
+
+// Frees the frame sent and starts the next queued one
+// A frame streamed since the event was posted may have finished it already
+void txDoneHandler(uint32_t arg)
+{
+    if (etherIsTxDone())
+        etherTxComplete();
+}
+
+void timerHandler(uint32_t arg)
+{
+    timerService();
+}
+
+void logHandler(uint32_t arg)
+{
+    logDrain();
+}
+
+// Statistics, on the open session if subscribed, otherwise with a
+// connection of its own once idle (retried every second until then)
+void statsHandler(uint32_t arg)
+{
+    if (NextState == subAck)
+    {
+        publishStats();
+        statsCounter = 0;
+    }
+    else if (!(publishFlag | subscribeFlag | connectFlag))
+    {
+        statsFlag = 1;
+        publishFlag = 1;
+        NextState = closed;
+        statsCounter = 0;
+    }
+}
+
+// The push button publishes the statistics on demand
+void buttonHandler(uint32_t arg)
+{
+    if (!schedIsQueued(EVENT_STATS))
+        schedPost(EVENT_STATS, 0);
+}
+
+void mqttStep(pbuf* frame);
+void rxFrameHandler(uint32_t arg);
+void mqttHandler(uint32_t arg);
+
+// Brings up the hardware, configuration and eth0
+void initApp()
+{
+    bool configValid, warmStart;
 
     // Init controller
     initHw();
 
     // Setup UART0
     initUart0();
-    setUart0BaudRate(115200, 40e6);
+    setUart0BaudRate(115200, SYSTEM_CLOCK);
+    initLog();
+    initPerf();
+    initSched();
+    initPbuf();
 
+    // Load configuration into ram once, nothing below reads the eeprom again
     initEeprom();
+    configValid = loadConfig();
+    if (!configValid)
+        putsUart0("\n\rNo valid configuration, using defaults");
 
     // Init ethernet interface (eth0)
-    putsUart0("\n\rStarting eth0\n\r"); //192, 168, 10, 138
-    etherSetIpAddress(readEeprom(1),readEeprom(2),readEeprom(3),readEeprom(4));
-    etherSetMacAddress(2, 3, 4, 5, 6, 7);
+    putsUart0("\n\rStarting eth0\n\r");
+    etherSetIpAddress(cfg.fields.ip[0], cfg.fields.ip[1], cfg.fields.ip[2], cfg.fields.ip[3]);
+    etherSetMacAddress(cfg.fields.mac[0], cfg.fields.mac[1], cfg.fields.mac[2],
+                       cfg.fields.mac[3], cfg.fields.mac[4], cfg.fields.mac[5]);
 
-    // Unicast is needed to respond to others MAC
-    // Broadcast is needed to repond to "who are you?"
+    // Filters follow the stack: unicast for us, arp requests for our ip
+    // and broadcasts only while dhcp is on (see etherUpdateFilters)
     // HALFDUPLEX gurantees that TX and RX are not done at same time
-    etherInit(ETHER_UNICAST | ETHER_BROADCAST | ETHER_HALFDUPLEX);
+    etherInit(ETHER_AUTOFILTER | ETHER_HALFDUPLEX);
     // we are using local administration MAC assignment so it could be anything
     // clears a bit in memory to disable DHCP
     etherDisableDhcpMode();
     // needs to be replaced by the number assigned to the group
 
 
-    etherSetIpSubnetMask(255, 255, 255, 0);
+    etherSetIpSubnetMask(cfg.fields.subnetMask[0], cfg.fields.subnetMask[1],
+                         cfg.fields.subnetMask[2], cfg.fields.subnetMask[3]);
     // this is the address that gets you to the web
-    etherSetIpGatewayAddress(192, 168, 10, 1);
+    etherSetIpGatewayAddress(cfg.fields.gateway[0], cfg.fields.gateway[1],
+                             cfg.fields.gateway[2], cfg.fields.gateway[3]);
+    etherSetMqttBrokerAddress(cfg.fields.broker[0], cfg.fields.broker[1],
+                              cfg.fields.broker[2], cfg.fields.broker[3]);
+    etherSetMqttClientId(cfg.fields.clientId);
+    // reuse the broker mac and session parameters from the last run
+    warmStart = etherLoadWarmStart();
+    if (warmStart)
+        putsUart0("Warm start, broker mac and session from the last run\n\r");
+    LOG2(LOG_BOOT, configValid, warmStart);
     // wait for the chip to settle down
     waitMicrosecond(100000);
     // dump all the settings to ethernet chip
     displayConnectionInfo();
+    timerStart(&secondTimer, TIMER_SECONDS(1), TIMER_SECONDS(1), secondTick, NULL);
+    timerStart(&buttonTimer, BUTTON_SAMPLE_TIME, BUTTON_SAMPLE_TIME, sampleButton, NULL);
+
+    // Event handlers by subsystem, and the sources polled for them
+    schedRegister(EVENT_RX_FRAME, rxFrameHandler);
+    schedRegister(EVENT_TX_DONE, txDoneHandler);
+    schedRegister(EVENT_MQTT, mqttHandler);
+    schedRegister(EVENT_TIMER, timerHandler);
+    schedRegister(EVENT_UART_LINE, shellExecute);
+    schedRegister(EVENT_BUTTON, buttonHandler);
+    schedRegister(EVENT_LOG, logHandler);
+    schedRegister(EVENT_STATS, statsHandler);
+    schedAddSource(rxSource);
+    schedAddSource(txSource);
+    schedAddSource(timerSource);
+    schedAddSource(uartSource);
+    schedAddSource(mqttSource);
+    schedAddSource(logSource);
 
     // Flash LED to make sure everything went well
     setPinValue(GREEN_LED, 1);
@@ -227,196 +374,252 @@ int main(void)
 //    putsUart0("Please enter the command");
 //    putcUart0(0x0a); putcUart0(0x0d); putsUart0(">>");
 //
+}
 
+// Takes one frame out of the receive ring and answers it
+// The handler owns the frame: responses reuse it and go to the tx queue,
+// segments on the mqtt connection are lent to the state machine right away
+// (so acks go out at this priority) and everything else is freed
+void rxFrameHandler(uint32_t arg)
+{
+    pbuf* frame;
+    uint8_t* data;
 
-    // Main Loop
-    // RTOS and interrupts would greatly improve this code,
-    // but the goal here is simplicity
-    while (true)
+    if (etherIsOverflow())
     {
+        LOG0(LOG_RX_OVERFLOW);
+        setPinValue(RED_LED, 1);
+        timerStart(&ledTimer, LED_BLINK_TIME, 0, redLedOff, NULL);
+    }
 
-       // Put terminal processing here
-        if (kbhitUart0())
-        {
-            shell();
-        }
+    // Get packet, it is dropped if the pool is empty
+    frame = etherGetFrame();
+    if (frame == NULL)
+        return;
+    data = frame->data;
+    LOG2(LOG_RX_FRAME, (data[12] << 8) | data[13], frame->size);
+    PERF_BEGIN(PERF_DISPATCH);
 
-        // Packet processing
-        if (etherIsDataAvailable())
-        {
-            if (etherIsOverflow())
-            {
-                setPinValue(RED_LED, 1);
-                waitMicrosecond(100000);
-                setPinValue(RED_LED, 0);
-            }
+    // Handle ARP request
+    if (etherIsArpRequest(data))
+    {
+        etherSendArpResponse(frame);
+        frame = NULL;
+    }
 
-            // Get packet
-            etherGetPacket(data, MAX_PACKET_SIZE);
+    // Learn addresses we asked for
+    else if (etherIsArpResponse(data))
+    {
+        etherProcessArpResponse(data);
+    }
 
-            // Handle ARP request
-            if (etherIsArpRequest(data))
+    // Handle IP datagram
+    else if (etherIsIp(data, frame->size))
+    {
+        if (etherIsIpUnicast(data))
+        {
+            // handle icmp ping request
+            if (etherIsPingRequest(data))
             {
-                etherSendArpResponse(data);
+              etherSendPingResponse(frame);
+              frame = NULL;
             }
 
-         //    Handle IP datagram
-            if (etherIsIp(data))
+            // only segments on the mqtt connection drive the state machine
+            else if (etherIsTcp(data, frame->size) && etherIsTcpConnection(data))
             {
-                if (etherIsIpUnicast(data))
-                {
-                    // handle icmp ping request
-                    if (etherIsPingRequest(data))
-                    {
-                      etherSendPingResponse(data);
-                    }
-                }
-                }
+                PERF_END(PERF_DISPATCH);
+                if (publishFlag | subscribeFlag | connectFlag)
+                    mqttStep(frame);
+                pbufFree(frame);
+                return;
             }
+        }
+    }
+    PERF_END(PERF_DISPATCH);
+    pbufFree(frame);
+}
 
-        if(publishFlag | subscribeFlag | connectFlag)
-        {
-        switch(NextState)
+void mqttHandler(uint32_t arg)
+{
+    if (publishFlag | subscribeFlag | connectFlag)
+        mqttStep(NULL);
+}
+
+void mqttSetState(TCPState state)
+{
+    NextState = state;
+    mqttThreadState = state;
+}
+
+// Drops the request, the broker is left to time the connection out
+void mqttGiveUp()
+{
+    LOG1(LOG_MQTT_TIMEOUT, NextState);
+    timerStop(&keepaliveTimer);
+    publishFlag = 0;
+    statsFlag = 0;
+    subscribeFlag = 0;
+    connectFlag = 0;
+    mqttSetState(closed);
+}
+
+// Waits for a segment on the connection matching c, giving the request up
+// if none comes within MQTT_REPLY_TIME
+#define MQTT_WAIT_SEGMENT(p, c) \
+    do { \
+        PT_WAIT_UNTIL_TIMEOUT(p, &mqttTimer, MQTT_REPLY_TIME, mqttSegment && (c)); \
+        if (PT_TIMED_OUT(p)) { mqttGiveUp(); PT_EXIT(p); } \
+        mqttSegment = false; \
+    } while (0)
+
+// The request set up by the shell (conn, pub or sub), from the handshake to
+// TIME_WAIT. NextState follows along for the shell, the log and perf
+PT_THREAD(mqttThread(pt* p))
+{
+    uint32_t keepaliveInterval;
+
+    PT_BEGIN(p);
+
+    sendSyn();
+    mqttSetState(SynSent);
+    MQTT_WAIT_SEGMENT(p, isEtherSYNACK(mqttFrame->data));
+    mqttSetState(SynAckRcvd);
+    sendAck(mqttFrame->data);
+    mqttSetState(Established);
+    sendConnectCmd();
+    if (connectFlag)
+        mqttSetState(sendAckState);
+    else if (subscribeFlag)
+        mqttSetState(subscribeMQTT);
+    else
+        mqttSetState(publishMQTT);
+    MQTT_WAIT_SEGMENT(p, isEtherConnectACK(mqttFrame->data));
+    sendAck(mqttFrame->data);
+    etherSaveWarmStart();
+
+    // conn only opens the session
+    if (connectFlag)
+    {
+        connectFlag = 0;
+        mqttSetState(closed);
+        PT_EXIT(p);
+    }
+
+    if (subscribeFlag)
+    {
+        subscribeRequest(mqttTopic);
+        mqttSetState(subAck);
+        MQTT_WAIT_SEGMENT(p, isEtherSubACK(mqttFrame->data));
+        sendAck(mqttFrame->data);
+        etherSaveWarmStart();
+        LOG0(LOG_SUBSCRIBED);
+
+        // ping at 2/3 of the keepalive interval
+        pingFlag = 0;
+        keepaliveInterval = TIMER_SECONDS(etherGetMqttKeepAlive()) / 3 * 2;
+        if (keepaliveInterval != 0)
+            timerStart(&keepaliveTimer, keepaliveInterval, keepaliveInterval, setFlag, &pingFlag);
+
+        // deliver publishes until unsub
+        while (NextState != sendUnsubReq)
         {
-            case closed:
-                sendSyn(data);
-                NextState = SynSent;
-                break;
-
-            case SynSent:
-                if(isEtherSYNACK(data))
-                  {NextState = SynAckRcvd;}
-                break;
-
-            case SynAckRcvd:
-                sendAck(data);
-                NextState = Established;
-                break;
-
-
-            case Established:
-           //     putsUart0("\n\rCurrent state: Established\n\r");
-                sendConnectCmd(data);
-                if(publishFlag){NextState = publishMQTT;}
-                if(subscribeFlag){NextState = subscribeMQTT;}
-                if(connectFlag){NextState = sendAckState;}
-                break;
-
-
-            case sendAckState:
-                if(isEtherConnectACK(data))
-                  {
-                    sendAck(data);
-                    if(connectFlag){NextState = closed;connectFlag = 0;}
-                  }
-                break;
-
-            case publishMQTT:
-                if(isEtherConnectACK(data))
-                  {
-                    sendAck(data);
-                    publishMqttMessage(data);
-                    NextState = disconnectReq;
-                  }
-                break;
-
-            case subscribeMQTT:
-              //  putsUart0("\n\rCurrent state: Subscribe MQTT\n\r");
-                if(isEtherConnectACK(data))
-                  {
-                    sendAck(data);
-                    subscribeRequest(data);
-                    NextState = subAck;
-                  //  putsUart0("\n\rCurrent state: subAck\n\r");
-                  }
-                break;
-
-            case disconnectReq:
-             //   putsUart0("\n\rCurrent state: disconnect Req\n\r");
-                if(isEtherACK(data))
-                  {
-                    disconnectRequest(data);
-                    NextState = FinWait1;
-                  }
-
-                break;
-
-            case subAck:
-               // putsUart0("\n\rCurrent state: subAck\n\r");
-                if(isEtherSubACK(data))
-                  {
-                    sendAck(data);
-                    putsUart0("\r\n Subscription Successful \n\r");
-                    TIMER1_TAV_R=0; // reset the timer
-                    timerCounter = 0;
-                  }
-
-                if(isEtherMqttPublish(data))
-                {
-                    getMqttMessage(data);
-                    sendAck(data);
-                }
-
-                if(TIMER1_TAV_R>40e6)
-                {
-                    timerCounter++;
-                    TIMER1_TAV_R=0;
-                }
-
-                if(timerCounter>40)
-                {
-                    sendPingRequest(data);
-                    timerCounter = 0;
-                }
-
-                if(isEtherMqttPingResponse(data))
-                {
-                    sendAck(data);
-                }
-
-                break;
-
-
-            case sendUnsubReq:
-                UnSubscribeRequest(data);
-                NextState = unSubAck;
-                break;
-
-            case unSubAck:
-                if(isEtherUnSubACK(data))
-                  {
-                    sendAck(data);
-                    putsUart0("\r\n Unsubscribed Sucessfully \n\r");
-                    NextState = TimeWait;
-                  }
-                break;
-
-            case FinWait1:
-                if(isEtherFINACK(data))
-                  {
-                    NextState = FinWait2;
-                  }
-                break;
-
-            case FinWait2:
-                sendAck(data);
-                NextState = TimeWait;
-                break;
-
-            case TimeWait:
-                waitMicrosecond(100000);
-                if(publishFlag){putsUart0("\r\n Publish Success \n\r");}
-                NextState = closed;
-                publishFlag = 0;
-                subscribeFlag = 0;
-                break;
+            PT_WAIT_UNTIL(p, mqttSegment || pingFlag || NextState == sendUnsubReq);
+            if (mqttSegment && isEtherMqttPublish(mqttFrame->data))
+            {
+                getMqttMessage(mqttFrame->data);
+                sendAck(mqttFrame->data);
             }
+            if (mqttSegment && isEtherMqttPingResponse(mqttFrame->data))
+                sendAck(mqttFrame->data);
+            mqttSegment = false;
+            if (pingFlag)
+            {
+                sendPingRequest();
+                LOG1(LOG_PING, etherGetMqttKeepAlive());
+                pingFlag = 0;
             }
+        }
 
+        timerStop(&keepaliveTimer);
+        UnSubscribeRequest(mqttTopic);
+        mqttSetState(unSubAck);
+        MQTT_WAIT_SEGMENT(p, isEtherUnSubACK(mqttFrame->data));
+        sendAck(mqttFrame->data);
+        LOG0(LOG_UNSUBSCRIBED);
+    }
+    else
+    {
+        if (statsFlag)
+            publishStats();
+        else
+            publishMqttMessage(mqttTopic, (uint8_t*)mqttMessage, strlen(mqttMessage));
+        mqttSetState(disconnectReq);
+        MQTT_WAIT_SEGMENT(p, isEtherACK(mqttFrame->data));
+        disconnectRequest();
+        mqttSetState(FinWait1);
+        MQTT_WAIT_SEGMENT(p, isEtherFINACK(mqttFrame->data));
+        mqttSetState(FinWait2);
+        sendAck(mqttFrame->data);
+    }
 
+    mqttSetState(TimeWait);
+    PT_SLEEP(p, &mqttTimer, TIME_WAIT_TIME);
+    if (publishFlag)
+        LOG0(LOG_PUBLISHED);
+    publishFlag = 0;
+    statsFlag = 0;
+    subscribeFlag = 0;
+    mqttSetState(closed);
 
-        }
+    PT_END(p);
+}
+
+// Runs the request thread until it blocks
+// frame is a segment on the connection (or NULL), lent for this call only
+void mqttStep(pbuf* frame)
+{
+    TCPState state = NextState;
+    PERF_BEGIN(mqttState);
+
+    // a new request from the shell starts over
+    if (NextState == closed && mqttThreadState != closed)
+    {
+        timerStop(&keepaliveTimer);
+        mqttThreadState = closed;
+        PT_INIT(&mqttPt);
+    }
+    mqttFrame = frame;
+    mqttSegment = frame != NULL;
+    mqttThread(&mqttPt);
+    mqttFrame = NULL;
+    mqttSegment = false;
+
+    PERF_END_AS(mqttState, PERF_MQTT_SYN_SENT + state);
+
+    if (NextState != lastState)
+    {
+        LOG2(LOG_STATE, lastState, NextState);
+        lastState = NextState;
     }
+}
+
+// One pass of the main loop: poll the event sources, run one handler
+// Split out of main so the host build can drive it (see host/)
+void pollApp()
+{
+    schedRun();
+}
+
+int main(void)
+{
+    initApp();
+
+    // Main Loop
+    // Run-to-completion event handlers, see sched.c
+    while (true)
+        pollApp();
+}
 
 
 //					// Process UDP datagram
@@ -425,7 +628,7 @@ int main(void)
 //					//   send the udp datagram (-d) to 192.168.1.199, port 1024 (-ud)
 //					// sudo sendip -p ipv4 -is 192.168.1.198 -p udp -ud 1024 -d "on" 192.168.1.199
 //                    // sudo sendip -p ipv4 -is 192.168.1.198 -p udp -ud 1024 -d "off" 192.168.1.199
-//					if (etherIsUdp(data))
+//					if (etherIsUdp(data, frame->size))
 //					{
 //						udpData = etherGetUdpData(data);
 //						if (strcmp((char*)udpData, "on") == 0)
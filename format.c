@@ -0,0 +1,183 @@
+// Formatting Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Small replacements for sprintf on the console path
+// Each routine writes a null terminated string into the caller's buffer and
+// returns its length; the Uart0 variants format on the stack and queue the
+// result in the uart0 tx ring in one write
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart0.h"
+#include "format.h"
+
+#ifdef FORMAT_BENCHMARK
+#include <stdio.h>
+#include "perf.h"
+#endif
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+const char hexDigits[16] = {'0','1','2','3','4','5','6','7','8','9','a','b','c','d','e','f'};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Writes value in decimal, str must hold FORMAT_DECIMAL_SIZE characters
+uint8_t formatDecimal(char str[], uint32_t value)
+{
+    char digits[10];
+    uint8_t count = 0;
+    uint8_t i;
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    }
+    while (value != 0);
+    for (i = 0; i < count; i++)
+        str[i] = digits[count - 1 - i];
+    str[count] = 0;
+    return count;
+}
+
+// Writes value in decimal, right aligned with spaces to at least width characters
+uint8_t formatDecimalWidth(char str[], uint32_t value, uint8_t width)
+{
+    char digits[FORMAT_DECIMAL_SIZE];
+    uint8_t size = formatDecimal(digits, value);
+    uint8_t pad = (width > size) ? width - size : 0;
+    uint8_t i;
+    for (i = 0; i < pad; i++)
+        str[i] = ' ';
+    for (i = 0; i <= size; i++)
+        str[pad + i] = digits[i];
+    return pad + size;
+}
+
+// Writes the low digits (1-8) hex digits of value in lower case with leading zeros
+uint8_t formatHex(char str[], uint32_t value, uint8_t digits)
+{
+    uint8_t i;
+    for (i = 0; i < digits; i++)
+        str[i] = hexDigits[(value >> ((digits - 1 - i) * 4)) & 0xF];
+    str[digits] = 0;
+    return digits;
+}
+
+// Writes a dotted quad, str must hold FORMAT_IP_SIZE characters
+uint8_t formatIp(char str[], const uint8_t ip[4])
+{
+    uint8_t size = 0;
+    uint8_t i;
+    for (i = 0; i < 4; i++)
+    {
+        size += formatDecimal(&str[size], ip[i]);
+        if (i < 4-1)
+            str[size++] = '.';
+    }
+    return size;
+}
+
+// Writes a colon separated mac address, str must hold FORMAT_MAC_SIZE characters
+uint8_t formatMac(char str[], const uint8_t mac[6])
+{
+    uint8_t size = 0;
+    uint8_t i;
+    for (i = 0; i < 6; i++)
+    {
+        str[size++] = hexDigits[mac[i] >> 4];
+        str[size++] = hexDigits[mac[i] & 0xF];
+        if (i < 6-1)
+            str[size++] = ':';
+    }
+    str[size] = 0;
+    return size;
+}
+
+void putDecimalUart0(uint32_t value)
+{
+    char str[FORMAT_DECIMAL_SIZE];
+    writeUart0(str, formatDecimal(str, value), UART0_BLOCK);
+}
+
+void putHexUart0(uint32_t value, uint8_t digits)
+{
+    char str[FORMAT_HEX_SIZE];
+    writeUart0(str, formatHex(str, value, digits), UART0_BLOCK);
+}
+
+void putIpUart0(const uint8_t ip[4])
+{
+    char str[FORMAT_IP_SIZE];
+    writeUart0(str, formatIp(str, ip), UART0_BLOCK);
+}
+
+void putMacUart0(const uint8_t mac[6])
+{
+    char str[FORMAT_MAC_SIZE];
+    writeUart0(str, formatMac(str, mac), UART0_BLOCK);
+}
+
+// Writes "label value" on its own line with the value right aligned
+void putCounterUart0(const char label[], uint32_t value)
+{
+    char str[FORMAT_DECIMAL_SIZE + 3];
+    uint8_t size;
+    putsUart0((char*)label);
+    size = formatDecimalWidth(str, value, 10);
+    str[size++] = '\n';
+    str[size++] = '\r';
+    writeUart0(str, size, UART0_BLOCK);
+}
+
+#ifdef FORMAT_BENCHMARK
+// Prints the cycles taken to format an ip and a mac address with sprintf
+// (as displayConnectionInfo used to) and with the routines above
+// Build with FORMAT_BENCHMARK defined and run the fmtbench command
+void formatBenchmark()
+{
+    const uint8_t ip[4] = {192, 168, 10, 138};
+    const uint8_t mac[6] = {0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    char str[FORMAT_MAC_SIZE];
+    uint32_t start, sprintfCycles, formatCycles;
+    uint8_t i;
+
+    CORE_DEMCR_R |= CORE_DEMCR_TRCENA;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+
+    start = DWT_CYCCNT_R;
+    for (i = 0; i < 4; i++)
+        sprintf(str, "%u", ip[i]);
+    for (i = 0; i < 6; i++)
+        sprintf(str, "%02x", mac[i]);
+    sprintfCycles = DWT_CYCCNT_R - start;
+
+    start = DWT_CYCCNT_R;
+    formatIp(str, ip);
+    formatMac(str, mac);
+    formatCycles = DWT_CYCCNT_R - start;
+
+    putCounterUart0("sprintf cycles: ", sprintfCycles);
+    putCounterUart0("format cycles:  ", formatCycles);
+}
+#else
+void formatBenchmark()
+{
+    putsUart0("Build with FORMAT_BENCHMARK defined\n\r");
+}
+#endif
@@ -0,0 +1,43 @@
+// Formatting Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Buffer sizes including the terminating null
+#define FORMAT_DECIMAL_SIZE 11    // 4294967295
+#define FORMAT_HEX_SIZE     9     // ffffffff
+#define FORMAT_IP_SIZE      16    // 255.255.255.255
+#define FORMAT_MAC_SIZE     18    // ff:ff:ff:ff:ff:ff
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t formatDecimal(char str[], uint32_t value);
+uint8_t formatDecimalWidth(char str[], uint32_t value, uint8_t width);
+uint8_t formatHex(char str[], uint32_t value, uint8_t digits);
+uint8_t formatIp(char str[], const uint8_t ip[4]);
+uint8_t formatMac(char str[], const uint8_t mac[6]);
+void putDecimalUart0(uint32_t value);
+void putHexUart0(uint32_t value, uint8_t digits);
+void putIpUart0(const uint8_t ip[4]);
+void putMacUart0(const uint8_t mac[6]);
+void putCounterUart0(const char label[], uint32_t value);
+void formatBenchmark();
+
+#endif
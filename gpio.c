@@ -7,7 +7,7 @@
 
 // Target Platform: EK-TM4C123GXL with LCD/Keyboard Interface
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // GPIO APB ports A-F
@@ -230,6 +230,22 @@ void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn)
     *p = (fn > 0);
 }
 
+// Switches between the aux function set by setPinAuxFunction and GPIO
+// without touching PCTL, so a pin can be handed back and forth cheaply
+void enablePinAuxFunction(PORT port, uint8_t pin)
+{
+    uint32_t* p;
+    p = (uint32_t*)port + pin + OFS_DATA_TO_AFSEL;
+    *p = 1;
+}
+
+void disablePinAuxFunction(PORT port, uint8_t pin)
+{
+    uint32_t* p;
+    p = (uint32_t*)port + pin + OFS_DATA_TO_AFSEL;
+    *p = 0;
+}
+
 void selectPinInterruptRisingEdge(PORT port, uint8_t pin)
 {
     uint32_t* p;
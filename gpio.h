@@ -33,6 +33,25 @@ typedef enum _PORT
     PORTF = 0x42000000 + (0x400253FC-0x40000000)*32
 } PORT;
 
+// Inline pin access for hot paths
+// With a constant port and pin the bit-band address is a constant, so these
+// compile to a single store or load instead of a call
+// (the host build defines GPIO_NO_BITBAND and maps them to the functions)
+#ifdef GPIO_NO_BITBAND
+#define setPinValueInline setPinValue
+#define getPinValueInline getPinValue
+#else
+static inline void setPinValueInline(PORT port, uint8_t pin, bool value)
+{
+    *((volatile uint32_t*)port + pin) = value;
+}
+
+static inline bool getPinValueInline(PORT port, uint8_t pin)
+{
+    return *((volatile uint32_t*)port + pin);
+}
+#endif
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -52,6 +71,8 @@ void enablePinPulldown(PORT port, uint8_t pin);
 void disablePinPulldown(PORT port, uint8_t pin);
 
 void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn);
+void enablePinAuxFunction(PORT port, uint8_t pin);
+void disablePinAuxFunction(PORT port, uint8_t pin);
 
 void selectPinInterruptRisingEdge(PORT port, uint8_t pin);
 void selectPinInterruptFallingEdge(PORT port, uint8_t pin);
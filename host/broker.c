@@ -0,0 +1,589 @@
+// MQTT Broker Stub
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "enc28j60.h"
+#include "broker.h"
+#include "sim.h"
+
+#define BROKER_QUEUE_SIZE   64
+#define BROKER_FRAME_SIZE   1518
+#define BROKER_FILTERS      8
+#define BROKER_FILTER_SIZE  64
+#define BROKER_MSS          1460
+#define BROKER_WINDOW       8192
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _brokerConnection
+{
+  bool open;
+  bool finSent;
+  uint8_t mac[6];
+  uint8_t ip[4];
+  uint16_t port;
+  uint32_t sendNext;
+  uint32_t sendUnacked;
+  uint32_t receiveNext;
+  uint8_t filterCount;
+  char filters[BROKER_FILTERS][BROKER_FILTER_SIZE];
+} brokerConnection;
+
+typedef struct _brokerFrame
+{
+  uint64_t due;
+  uint16_t size;
+  uint8_t data[BROKER_FRAME_SIZE];
+} brokerFrame;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+brokerStats broker;
+uint8_t brokerMac[6];
+uint8_t brokerIp[4];
+uint32_t brokerTurnaround;
+brokerPublishHandler brokerOnPublish = 0;
+brokerConnection brokerConnections[BROKER_CONNECTIONS];
+uint32_t brokerIss = 0x10000000;
+
+// Frames on their way to the device, in order of delivery
+brokerFrame brokerQueue[BROKER_QUEUE_SIZE];
+uint8_t brokerQueueHead = 0;
+uint8_t brokerQueueTail = 0;
+uint64_t brokerLinkFree = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint16_t brokerGet16(const uint8_t data[])
+{
+    return (data[0] << 8) | data[1];
+}
+
+uint32_t brokerGet32(const uint8_t data[])
+{
+    return ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+void brokerPut16(uint8_t data[], uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+void brokerPut32(uint8_t data[], uint32_t value)
+{
+    brokerPut16(data, value >> 16);
+    brokerPut16(&data[2], value & 0xFFFF);
+}
+
+uint32_t brokerSum(uint32_t sum, const uint8_t data[], uint16_t size)
+{
+    uint16_t i;
+    for (i = 0; i + 1 < size; i += 2)
+        sum += brokerGet16(&data[i]);
+    if (size & 1)
+        sum += data[size - 1] << 8;
+    return sum;
+}
+
+uint16_t brokerChecksum(uint32_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum & 0xFFFF;
+}
+
+// Sum of the tcp pseudo-header
+uint32_t brokerPseudoSum(const uint8_t source[4], const uint8_t dest[4], uint16_t size)
+{
+    uint32_t sum = brokerSum(0, source, 4);
+    sum = brokerSum(sum, dest, 4);
+    return sum + 6 + size;
+}
+
+void initBroker(const uint8_t mac[6], const uint8_t ip[4], uint32_t turnaroundCycles)
+{
+    memset(&broker, 0, sizeof(broker));
+    memset(brokerConnections, 0, sizeof(brokerConnections));
+    memcpy(brokerMac, mac, 6);
+    memcpy(brokerIp, ip, 4);
+    brokerTurnaround = turnaroundCycles;
+    brokerQueueHead = brokerQueueTail = 0;
+    brokerLinkFree = 0;
+}
+
+void brokerSetPublishHandler(brokerPublishHandler handler)
+{
+    brokerOnPublish = handler;
+}
+
+// Queues a frame for the device once the reply has been worked out and
+// the link is free
+void brokerQueueFrame(const uint8_t frame[], uint16_t size)
+{
+    brokerFrame* entry;
+    uint64_t start = simGetCycles() + brokerTurnaround;
+    if ((brokerQueueHead + 1) % BROKER_QUEUE_SIZE == brokerQueueTail)
+    {
+        broker.framesLost++;
+        return;
+    }
+    if (start < brokerLinkFree)
+        start = brokerLinkFree;
+    brokerLinkFree = start + ENC_WIRE_CYCLES(size);
+    entry = &brokerQueue[brokerQueueHead];
+    entry->due = brokerLinkFree;
+    entry->size = size;
+    memcpy(entry->data, frame, size);
+    brokerQueueHead = (brokerQueueHead + 1) % BROKER_QUEUE_SIZE;
+}
+
+// Delivers the frames that have finished crossing the wire
+void brokerPoll()
+{
+    brokerFrame* entry;
+    while (brokerQueueTail != brokerQueueHead && brokerQueue[brokerQueueTail].due <= simGetCycles())
+    {
+        entry = &brokerQueue[brokerQueueTail];
+        if (encInjectFrame(entry->data, entry->size))
+            broker.framesTx++;
+        else
+            broker.framesLost++;
+        brokerQueueTail = (brokerQueueTail + 1) % BROKER_QUEUE_SIZE;
+    }
+}
+
+// Returns the time the next queued frame arrives, or 0 if none are queued
+uint64_t brokerGetNextDue()
+{
+    if (brokerQueueTail == brokerQueueHead)
+        return 0;
+    return brokerQueue[brokerQueueTail].due;
+}
+
+void brokerSendSegment(brokerConnection* connection, uint8_t flags, const uint8_t data[], uint16_t size)
+{
+    uint8_t frame[BROKER_FRAME_SIZE];
+    uint8_t* ip = &frame[14];
+    uint8_t* tcp = &frame[34];
+    uint8_t headerSize = (flags & TCP_SYN) ? 24 : 20;
+    uint16_t tcpSize = headerSize + size;
+
+    memcpy(frame, connection->mac, 6);
+    memcpy(&frame[6], brokerMac, 6);
+    brokerPut16(&frame[12], 0x0800);
+
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    brokerPut16(&ip[2], 20 + tcpSize);
+    brokerPut16(&ip[6], 0x4000);
+    ip[8] = 64;
+    ip[9] = 6;
+    memcpy(&ip[12], brokerIp, 4);
+    memcpy(&ip[16], connection->ip, 4);
+    brokerPut16(&ip[10], brokerChecksum(brokerSum(0, ip, 20)));
+
+    memset(tcp, 0, headerSize);
+    brokerPut16(tcp, BROKER_PORT);
+    brokerPut16(&tcp[2], connection->port);
+    brokerPut32(&tcp[4], connection->sendNext);
+    brokerPut32(&tcp[8], connection->receiveNext);
+    tcp[12] = (headerSize / 4) << 4;
+    tcp[13] = flags;
+    brokerPut16(&tcp[14], BROKER_WINDOW);
+    if (flags & TCP_SYN)
+    {
+        tcp[20] = 2;
+        tcp[21] = 4;
+        brokerPut16(&tcp[22], BROKER_MSS);
+    }
+    if (size > 0)
+        memcpy(&tcp[headerSize], data, size);
+    brokerPut16(&tcp[16], brokerChecksum(brokerSum(brokerPseudoSum(brokerIp, connection->ip, tcpSize), tcp, tcpSize)));
+
+    connection->sendNext += size + ((flags & (TCP_SYN | TCP_FIN)) ? 1 : 0);
+    brokerQueueFrame(frame, 34 + tcpSize);
+}
+
+// Matches a topic against a filter with + and # wildcards
+bool brokerIsMatch(const char filter[], const char topic[])
+{
+    while (*filter != 0)
+    {
+        if (*filter == '#')
+            return true;
+        if (*filter == '+')
+        {
+            while (*topic != 0 && *topic != '/')
+                topic++;
+            filter++;
+        }
+        else if (*filter++ != *topic++)
+            return false;
+    }
+    return *topic == 0;
+}
+
+// Sends a publish at QoS 0 to every connection with a matching filter
+// Returns the number of deliveries
+uint8_t brokerPublish(const char topic[], const uint8_t payload[], uint16_t size)
+{
+    uint8_t packet[BROKER_FRAME_SIZE];
+    uint16_t topicSize = strlen(topic);
+    uint16_t length = 2 + topicSize + size;
+    uint16_t header = 0;
+    uint8_t count = 0;
+    uint8_t i, j;
+
+    if (length + 5 > BROKER_MSS)
+        return 0;
+    packet[header++] = 0x30;
+    do
+    {
+        packet[header] = length & 0x7F;
+        length >>= 7;
+        if (length > 0)
+            packet[header] |= 0x80;
+        header++;
+    }
+    while (length > 0);
+    brokerPut16(&packet[header], topicSize);
+    memcpy(&packet[header + 2], topic, topicSize);
+    memcpy(&packet[header + 2 + topicSize], payload, size);
+
+    for (i = 0; i < BROKER_CONNECTIONS; i++)
+    {
+        brokerConnection* connection = &brokerConnections[i];
+        if (!connection->open)
+            continue;
+        for (j = 0; j < connection->filterCount; j++)
+        {
+            if (brokerIsMatch(connection->filters[j], topic))
+            {
+                brokerSendSegment(connection, TCP_PSH | TCP_ACK, packet, header + 2 + topicSize + size);
+                broker.publishesTx++;
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+void brokerCopyString(char dest[], const uint8_t data[], uint16_t size, uint16_t maxSize)
+{
+    if (size >= maxSize)
+        size = maxSize - 1;
+    memcpy(dest, data, size);
+    dest[size] = 0;
+}
+
+// Handles the mqtt packets in a segment, writing any replies to response
+// Returns the size of the response
+uint16_t brokerProcessMqtt(brokerConnection* connection, const uint8_t data[], uint16_t size,
+                           uint8_t response[])
+{
+    char topic[BROKER_FILTER_SIZE];
+    uint16_t responseSize = 0;
+    uint16_t offset = 0, length, topicSize, id, position, ackStart, i;
+    uint8_t type, qos, shift;
+
+    while (offset < size)
+    {
+        type = data[offset];
+        length = 0;
+        shift = 0;
+        position = offset + 1;
+        do
+        {
+            length |= (data[position] & 0x7F) << shift;
+            shift += 7;
+        }
+        while ((data[position++] & 0x80) && position < size);
+        if (position + length > size)
+            break;
+
+        switch (type >> 4)
+        {
+            case 1:     // CONNECT
+                broker.connects++;
+                connection->filterCount = 0;
+                memcpy(&response[responseSize], "\x20\x02\x00\x00", 4);
+                responseSize += 4;
+                break;
+            case 3:     // PUBLISH
+                qos = (type >> 1) & 3;
+                topicSize = brokerGet16(&data[position]);
+                brokerCopyString(topic, &data[position + 2], topicSize, sizeof(topic));
+                i = 2 + topicSize;
+                id = 0;
+                if (qos > 0)
+                {
+                    id = brokerGet16(&data[position + i]);
+                    i += 2;
+                }
+                broker.publishesRx++;
+                if (brokerOnPublish != 0)
+                    brokerOnPublish(topic, &data[position + i], length - i, qos, simGetCycles());
+                if (qos > 0)
+                {
+                    response[responseSize++] = (qos == 1) ? 0x40 : 0x50;    // PUBACK or PUBREC
+                    response[responseSize++] = 2;
+                    brokerPut16(&response[responseSize], id);
+                    responseSize += 2;
+                }
+                brokerPublish(topic, &data[position + i], length - i);
+                break;
+            case 6:     // PUBREL
+                response[responseSize++] = 0x70;
+                response[responseSize++] = 2;
+                brokerPut16(&response[responseSize], brokerGet16(&data[position]));
+                responseSize += 2;
+                break;
+            case 8:     // SUBSCRIBE
+                id = brokerGet16(&data[position]);
+                ackStart = responseSize;
+                response[responseSize++] = 0x90;
+                response[responseSize++] = 2;
+                brokerPut16(&response[responseSize], id);
+                responseSize += 2;
+                i = 2;
+                while (i < length)
+                {
+                    topicSize = brokerGet16(&data[position + i]);
+                    if (connection->filterCount < BROKER_FILTERS)
+                        brokerCopyString(connection->filters[connection->filterCount++],
+                                         &data[position + i + 2], topicSize, BROKER_FILTER_SIZE);
+                    i += 2 + topicSize + 1;
+                    response[responseSize++] = 0;   // granted QoS 0
+                    response[ackStart + 1]++;
+                }
+                broker.subscribes++;
+                break;
+            case 10:    // UNSUBSCRIBE
+                id = brokerGet16(&data[position]);
+                i = 2;
+                while (i < length)
+                {
+                    topicSize = brokerGet16(&data[position + i]);
+                    brokerCopyString(topic, &data[position + i + 2], topicSize, sizeof(topic));
+                    for (shift = 0; shift < connection->filterCount; shift++)
+                    {
+                        if (strcmp(connection->filters[shift], topic) == 0)
+                        {
+                            memmove(connection->filters[shift], connection->filters[shift + 1],
+                                    (connection->filterCount - shift - 1) * BROKER_FILTER_SIZE);
+                            connection->filterCount--;
+                            break;
+                        }
+                    }
+                    i += 2 + topicSize;
+                }
+                response[responseSize++] = 0xB0;
+                response[responseSize++] = 2;
+                brokerPut16(&response[responseSize], id);
+                responseSize += 2;
+                break;
+            case 12:    // PINGREQ
+                broker.pings++;
+                memcpy(&response[responseSize], "\xD0\x00", 2);
+                responseSize += 2;
+                break;
+        }
+        offset = position + length;
+    }
+    return responseSize;
+}
+
+brokerConnection* brokerFindConnection(const uint8_t ip[4], uint16_t port)
+{
+    uint8_t i;
+    for (i = 0; i < BROKER_CONNECTIONS; i++)
+    {
+        if (brokerConnections[i].open && brokerConnections[i].port == port
+            && memcmp(brokerConnections[i].ip, ip, 4) == 0)
+            return &brokerConnections[i];
+    }
+    return NULL;
+}
+
+void brokerProcessTcp(const uint8_t frame[], const uint8_t ip[], const uint8_t tcp[], uint16_t tcpSize)
+{
+    brokerConnection* connection;
+    uint8_t response[BROKER_FRAME_SIZE];
+    uint16_t responseSize = 0;
+    uint8_t headerSize = (tcp[12] >> 4) * 4;
+    uint8_t flags = tcp[13];
+    uint16_t port = brokerGet16(tcp);
+    uint32_t seq = brokerGet32(&tcp[4]);
+    uint32_t ack = brokerGet32(&tcp[8]);
+    uint16_t dataSize = tcpSize - headerSize;
+    uint8_t i;
+
+    if (brokerChecksum(brokerSum(brokerPseudoSum(&ip[12], brokerIp, tcpSize), tcp, tcpSize)) != 0)
+    {
+        broker.checksumErrors++;
+        return;
+    }
+    if (brokerGet16(&tcp[2]) != BROKER_PORT)
+        return;
+    connection = brokerFindConnection(&ip[12], port);
+
+    if (flags & TCP_RST)
+    {
+        if (connection != NULL)
+            connection->open = false;
+        return;
+    }
+    if (flags & TCP_SYN)
+    {
+        if (connection == NULL)
+        {
+            connection = &brokerConnections[0];
+            for (i = 0; i < BROKER_CONNECTIONS; i++)
+            {
+                if (!brokerConnections[i].open)
+                {
+                    connection = &brokerConnections[i];
+                    break;
+                }
+            }
+        }
+        memset(connection, 0, sizeof(*connection));
+        connection->open = true;
+        memcpy(connection->mac, &frame[6], 6);
+        memcpy(connection->ip, &ip[12], 4);
+        connection->port = port;
+        connection->sendNext = brokerIss;
+        brokerIss += 0x01000000;
+        connection->receiveNext = seq + 1;
+        brokerSendSegment(connection, TCP_SYN | TCP_ACK, NULL, 0);
+        connection->sendUnacked = connection->sendNext;
+        return;
+    }
+    if (connection == NULL)
+        return;
+
+    if ((flags & TCP_ACK) && (ack - connection->sendUnacked) <= (connection->sendNext - connection->sendUnacked))
+    {
+        connection->sendUnacked = ack;
+        if (connection->finSent && ack == connection->sendNext)
+        {
+            connection->open = false;
+            return;
+        }
+    }
+    if (dataSize == 0 && !(flags & TCP_FIN))
+        return;
+    if (seq != connection->receiveNext)
+    {
+        brokerSendSegment(connection, TCP_ACK, NULL, 0);
+        return;
+    }
+
+    connection->receiveNext += dataSize;
+    responseSize = brokerProcessMqtt(connection, &tcp[headerSize], dataSize, response);
+    if (flags & TCP_FIN)
+    {
+        connection->receiveNext++;
+        connection->finSent = true;
+        brokerSendSegment(connection, TCP_FIN | TCP_ACK, response, responseSize);
+    }
+    else if (responseSize > 0)
+        brokerSendSegment(connection, TCP_PSH | TCP_ACK, response, responseSize);
+    else
+        brokerSendSegment(connection, TCP_ACK, NULL, 0);
+}
+
+// Takes a frame sent by the device
+void brokerReceive(const uint8_t frame[], uint16_t size)
+{
+    uint8_t reply[42];
+    const uint8_t* ip = &frame[14];
+    uint16_t ipSize;
+    uint8_t headerSize;
+
+    broker.framesRx++;
+    if (size < 42)
+        return;
+    switch (brokerGet16(&frame[12]))
+    {
+        case 0x0806:
+            // answer requests for our address
+            if (brokerGet16(&frame[20]) == 1 && memcmp(&frame[38], brokerIp, 4) == 0)
+            {
+                memcpy(reply, &frame[6], 6);
+                memcpy(&reply[6], brokerMac, 6);
+                memcpy(&reply[12], &frame[12], 8);
+                brokerPut16(&reply[20], 2);
+                memcpy(&reply[22], brokerMac, 6);
+                memcpy(&reply[28], brokerIp, 4);
+                memcpy(&reply[32], &frame[22], 10);
+                brokerQueueFrame(reply, 42);
+            }
+            break;
+        case 0x0800:
+            headerSize = (ip[0] & 0xF) * 4;
+            ipSize = brokerGet16(&ip[2]);
+            if (memcmp(&ip[16], brokerIp, 4) != 0 || ip[9] != 6 || 14 + ipSize > size)
+                break;
+            if (brokerChecksum(brokerSum(0, ip, headerSize)) != 0)
+            {
+                broker.checksumErrors++;
+                break;
+            }
+            brokerProcessTcp(frame, ip, &ip[headerSize], ipSize - headerSize);
+            break;
+    }
+}
+
+// True if every byte sent has been acked and nothing is waiting to go out
+bool brokerIsAcked()
+{
+    uint8_t i;
+    if (brokerQueueTail != brokerQueueHead)
+        return false;
+    for (i = 0; i < BROKER_CONNECTIONS; i++)
+    {
+        if (brokerConnections[i].open && brokerConnections[i].sendUnacked != brokerConnections[i].sendNext)
+            return false;
+    }
+    return true;
+}
+
+uint8_t brokerGetSubscriptionCount()
+{
+    uint8_t count = 0;
+    uint8_t i;
+    for (i = 0; i < BROKER_CONNECTIONS; i++)
+    {
+        if (brokerConnections[i].open)
+            count += brokerConnections[i].filterCount;
+    }
+    return count;
+}
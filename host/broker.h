@@ -0,0 +1,67 @@
+// MQTT Broker Stub
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// A minimal MQTT 3.1.1 broker on the far end of the simulated link. It
+// answers arp for its address, accepts tcp connections on port 1883 and
+// handles CONNECT, PUBLISH (QoS 0, 1 and 2), SUBSCRIBE, UNSUBSCRIBE,
+// PINGREQ and DISCONNECT. Publishes are forwarded at QoS 0 to subscribers
+// whose filter matches (+ and # wildcards).
+//
+// Frames sent by the device are handed to brokerReceive. Replies are
+// queued and injected into the ENC28J60 model by brokerPoll once their
+// time on the wire (plus the turnaround time) has passed. There is no
+// retransmission, segments out of order are dropped and acked again.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef BROKER_H_
+#define BROKER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BROKER_PORT        1883
+#define BROKER_CONNECTIONS 4
+
+// Called for every publish received, at the time it arrived
+typedef void (*brokerPublishHandler)(const char topic[], const uint8_t payload[], uint16_t size,
+                                     uint8_t qos, uint64_t cycles);
+
+typedef struct _brokerStats
+{
+  uint32_t framesRx;
+  uint32_t framesTx;
+  uint32_t framesLost;      // replies the device's receive ring had no room for
+  uint32_t checksumErrors;
+  uint32_t connects;
+  uint32_t publishesRx;
+  uint32_t publishesTx;
+  uint32_t subscribes;
+  uint32_t pings;
+} brokerStats;
+
+extern brokerStats broker;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initBroker(const uint8_t mac[6], const uint8_t ip[4], uint32_t turnaroundCycles);
+void brokerSetPublishHandler(brokerPublishHandler handler);
+void brokerReceive(const uint8_t frame[], uint16_t size);
+void brokerPoll();
+uint64_t brokerGetNextDue();
+uint8_t brokerPublish(const char topic[], const uint8_t payload[], uint16_t size);
+bool brokerIsAcked();
+uint8_t brokerGetSubscriptionCount();
+
+#endif
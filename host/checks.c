@@ -0,0 +1,104 @@
+// Host Checks
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Checks results that the replay and benchmark harnesses cannot, because the
+// firmware and the ENC28J60 model would agree with each other even if both
+// were wrong. Expected values come from outside the tree. Prints each
+// failure and exits non-zero if there was one.
+//
+// Usage: checks
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "eth0.h"
+#include "enc28j60.h"
+#include "sim.h"
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _hashCase
+{
+  uint8_t mac[6];
+  uint8_t index;            // from Microchip's SetRXHashTableEntry
+} hashCase;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+const hashCase hashCases[] =
+{
+    {{0x01, 0x00, 0x5E, 0x00, 0x00, 0x01}, 63},     // all hosts
+    {{0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB}, 62},     // mDNS
+    {{0x33, 0x33, 0x00, 0x00, 0x00, 0x01}, 51},     // IPv6 all nodes
+    {{0x01, 0x80, 0xC2, 0x00, 0x00, 0x00}, 15},     // spanning tree
+};
+
+uint16_t failures = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void fail(const char name[], const uint8_t mac[6], unsigned got, unsigned expected)
+{
+    printf("FAIL %s %02x:%02x:%02x:%02x:%02x:%02x: got %u, expected %u\n", name,
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], got, expected);
+    failures++;
+}
+
+// Hash table index of the firmware and of the model against the reference
+void checkHashIndex()
+{
+    uint8_t i;
+    for (i = 0; i < sizeof(hashCases) / sizeof(hashCases[0]); i++)
+    {
+        if (etherGetHashIndex(hashCases[i].mac) != hashCases[i].index)
+            fail("etherGetHashIndex", hashCases[i].mac, etherGetHashIndex(hashCases[i].mac), hashCases[i].index);
+        if (encGetHashIndex(hashCases[i].mac) != hashCases[i].index)
+            fail("encGetHashIndex", hashCases[i].mac, encGetHashIndex(hashCases[i].mac), hashCases[i].index);
+    }
+}
+
+// A joined group gets through the hash table filter, others are refused
+void checkJoinMulticast()
+{
+    uint8_t frame[60];
+    memset(frame, 0, sizeof(frame));
+    frame[12] = 0x08;
+
+    initSim();
+    etherInit(ETHER_AUTOFILTER | ETHER_HALFDUPLEX);
+    etherJoinMulticast(hashCases[1].mac);
+    memcpy(frame, hashCases[1].mac, 6);
+    if (!encInjectFrame(frame, sizeof(frame)))
+        fail("joined group", frame, 0, 1);
+    // all hosts hashes to a different bit
+    memcpy(frame, hashCases[0].mac, 6);
+    if (encInjectFrame(frame, sizeof(frame)))
+        fail("other group", frame, 1, 0);
+}
+
+int main()
+{
+    checkHashIndex();
+    checkJoinMulticast();
+    if (failures == 0)
+        printf("all checks passed\n");
+    return failures != 0;
+}
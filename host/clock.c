@@ -0,0 +1,26 @@
+// System Clock Library (host)
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Virtual time already runs at SYSTEM_CLOCK (SIM_CLOCK), there is no PLL
+// to wait for
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "clock.h"
+#include "sim.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initClock() {}
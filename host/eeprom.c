@@ -0,0 +1,88 @@
+// EEPROM Library (host)
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// 2 KB of words starting erased (all ones), optionally loaded from and
+// saved to an image file so configuration and warm start survive a rerun
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "eeprom.h"
+#include "sim.h"
+
+#define EEPROM_WORDS 512
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+uint32_t eepromWords[EEPROM_WORDS];
+const char* eepromFile = NULL;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEeprom()
+{
+    FILE* file;
+    memset(eepromWords, 0xFF, sizeof(eepromWords));
+    if (eepromFile != NULL && (file = fopen(eepromFile, "rb")) != NULL)
+    {
+        fread(eepromWords, sizeof(uint32_t), EEPROM_WORDS, file);
+        fclose(file);
+    }
+}
+
+void saveEeprom()
+{
+    FILE* file;
+    if (eepromFile != NULL && (file = fopen(eepromFile, "wb")) != NULL)
+    {
+        fwrite(eepromWords, sizeof(uint32_t), EEPROM_WORDS, file);
+        fclose(file);
+    }
+}
+
+void writeEeprom(uint16_t add, uint32_t eedata)
+{
+    eepromWords[add % EEPROM_WORDS] = eedata;
+    saveEeprom();
+}
+
+uint32_t readEeprom(uint16_t add)
+{
+    return eepromWords[add % EEPROM_WORDS];
+}
+
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint8_t count)
+{
+    uint8_t i;
+    for (i = 0; i < count; i++)
+        eepromWords[(add + i) % EEPROM_WORDS] = data[i];
+    saveEeprom();
+}
+
+void readEepromBlock(uint16_t add, uint32_t data[], uint8_t count)
+{
+    uint8_t i;
+    for (i = 0; i < count; i++)
+        data[i] = eepromWords[(add + i) % EEPROM_WORDS];
+}
+
+void simSetEepromFile(const char file[])
+{
+    eepromFile = file;
+}
@@ -0,0 +1,594 @@
+// ENC28J60 Model
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Register numbers use the same encoding as eth0.c (bank in bits 6:5).
+// Registers 0x1B-0x1F are common to all banks and are kept in bank 0.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "enc28j60.h"
+
+// Instructions
+#define RCR 0
+#define RBM 1
+#define WCR 2
+#define WBM 3
+#define BFS 4
+#define BFC 5
+#define SRC 0xFF
+
+// Ether registers
+#define ERDPTL      0x00
+#define EWRPTL      0x02
+#define ETXSTL      0x04
+#define ETXNDL      0x06
+#define ERXSTL      0x08
+#define ERXNDL      0x0A
+#define ERXRDPTL    0x0C
+#define ERXWRPTL    0x0E
+#define EIE         0x1B
+#define INTIE   0x80
+#define EIR         0x1C
+#define RXERIF  0x01
+#define TXIF    0x08
+#define LINKIF  0x10
+#define PKTIF   0x40
+#define ESTAT       0x1D
+#define CLKRDY  0x01
+#define ECON2       0x1E
+#define PKTDEC  0x40
+#define AUTOINC 0x80
+#define ECON1       0x1F
+#define RXEN    0x04
+#define TXRTS   0x08
+#define EHT0        0x20
+#define EPMM0       0x28
+#define EPMCSL      0x30
+#define EPMCSH      0x31
+#define EPMOL       0x34
+#define EPMOH       0x35
+#define ERXFCON     0x38
+#define BCEN    0x01
+#define MCEN    0x02
+#define HTEN    0x04
+#define MPEN    0x08
+#define PMEN    0x10
+#define ANDOR   0x40
+#define UCEN    0x80
+#define EPKTCNT     0x39
+#define MACON3      0x42
+#define HFRMEN  0x04
+#define PADCFG  0xE0
+#define MAMXFLL     0x4A
+#define MICMD       0x52
+#define MIIRD   0x01
+#define MIREGADR    0x54
+#define MIWRL       0x56
+#define MIWRH       0x57
+#define MIRDL       0x58
+#define MIRDH       0x59
+#define MAADR5      0x60        // datasheet numbering, MAADR1 is the first byte
+#define MAADR6      0x61
+#define MAADR3      0x62
+#define MAADR4      0x63
+#define MAADR1      0x64
+#define MAADR2      0x65
+#define MISTAT      0x6A
+#define EREVID      0x72
+#define ECOCON      0x75
+
+// Phy registers
+#define PHCON1      0x00
+#define PHSTAT1     0x01
+#define LLSTAT 0x0004
+#define PHID1       0x02
+#define PHID2       0x03
+#define PHSTAT2     0x11
+#define LSTAT  0x0400
+#define PHIE        0x12
+#define PGEIE  0x0002
+#define PLNKIE 0x0010
+#define PHIR        0x13
+#define PLNKIF 0x0010
+#define PHLCON      0x14
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+uint8_t encRegisters[4][32];
+uint16_t encPhy[32];
+uint8_t encMemory[ENC_MEMORY_SIZE];
+bool encLinkUp = true;
+encTxHandler encTx = 0;
+uint32_t encRxFiltered = 0;
+uint32_t encRxOverflows = 0;
+
+// Frame on the wire, TXRTS stays set until encTxDoneAt
+uint8_t encTxFrame[ENC_MEMORY_SIZE];
+uint16_t encTxSize = 0;
+uint64_t encTxDoneAt = 0;
+bool encTxPending = false;
+
+// Current spi instruction
+bool encSelected = false;
+uint8_t encOpcode;
+uint16_t encBytes;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t* encRegister(uint8_t reg)
+{
+    if ((reg & 0x1F) >= EIE)
+        return &encRegisters[0][reg & 0x1F];
+    return &encRegisters[reg >> 5][reg & 0x1F];
+}
+
+uint16_t encGet16(uint8_t reg)
+{
+    return *encRegister(reg) | (*encRegister(reg + 1) << 8);
+}
+
+void encSet16(uint8_t reg, uint16_t value)
+{
+    *encRegister(reg) = value & 0xFF;
+    *encRegister(reg + 1) = (value >> 8) & 0x1F;
+}
+
+// Reflected crc-32 as used for the ethernet fcs (result is the value sent)
+uint32_t encCrc32(const uint8_t data[], uint16_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    uint16_t i;
+    uint8_t j;
+    for (i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Hash table index of a destination address, bits 28:23 of the crc register
+// The controller shifts the register msb first (the fcs is its complement
+// reflected), so the bits are taken from the reversed, uninverted fcs
+uint8_t encGetHashIndex(const uint8_t mac[6])
+{
+    uint32_t crc = ~encCrc32(mac, 6);
+    uint32_t reg = 0;
+    uint8_t i;
+    for (i = 0; i < 32; i++)
+        reg |= ((crc >> i) & 1) << (31 - i);
+    return (reg >> 23) & 0x3F;
+}
+
+// Values as set by a power-on or system reset (link state and handler persist)
+void encReset()
+{
+    memset(encRegisters, 0, sizeof(encRegisters));
+    memset(encPhy, 0, sizeof(encPhy));
+    encSet16(ERDPTL, 0x05FA);
+    encSet16(ERXSTL, 0x05FA);
+    encSet16(ERXNDL, 0x1FFF);
+    encSet16(ERXRDPTL, 0x05FA);
+    *encRegister(ECON2) = AUTOINC;
+    *encRegister(ERXFCON) = UCEN | 0x20 | BCEN;
+    encSet16(MAMXFLL, 0x0600);
+    *encRegister(EREVID) = 0x06;
+    *encRegister(ECOCON) = 0x04;
+    encPhy[PHID1] = 0x0083;
+    encPhy[PHID2] = 0x1400;
+    encPhy[PHLCON] = 0x3422;
+    encSelected = false;
+    encTxPending = false;
+}
+
+uint16_t encReadPhy(uint8_t reg)
+{
+    if (reg == PHSTAT1)
+        return 0x1800 | (encLinkUp ? LLSTAT : 0);
+    if (reg == PHSTAT2)
+        return (encLinkUp ? LSTAT : 0) | ((encPhy[PHCON1] & 0x0100) ? 0x0200 : 0);
+    return encPhy[reg & 0x1F];
+}
+
+uint8_t encReadRegister(uint8_t reg)
+{
+    uint8_t value = *encRegister(reg);
+    if (reg == EIR)
+        value = (value & ~PKTIF) | (*encRegister(EPKTCNT) != 0 ? PKTIF : 0);
+    if (reg == ESTAT)
+        value |= CLKRDY;
+    if (reg == MISTAT)
+        value = 0;
+    return value;
+}
+
+// Starts sending the frame between ETXST+1 and ETXND
+// The frame is latched now and leaves after its time on the wire (encUpdate)
+void encTransmit()
+{
+    uint16_t start = encGet16(ETXSTL);
+    uint16_t end = encGet16(ETXNDL);
+    uint16_t size = 0;
+
+    if (end > start)
+    {
+        size = end - start;
+        memcpy(encTxFrame, &encMemory[start + 1], size);
+    }
+    if ((*encRegister(MACON3) & PADCFG) != 0)
+    {
+        while (size < 60)
+            encTxFrame[size++] = 0;
+    }
+    encTxSize = size;
+    encTxDoneAt = simGetCycles() + ENC_WIRE_CYCLES(size);
+    encTxPending = true;
+}
+
+// Completes a transmit once its time on the wire has passed
+// Called by simAdvance
+void encUpdate()
+{
+    uint16_t end = encGet16(ETXNDL);
+    uint16_t size = encTxSize;
+    uint16_t i;
+
+    if (!encTxPending || simGetCycles() < encTxDoneAt)
+        return;
+    encTxPending = false;
+    if (encTx != 0 && encLinkUp)
+        encTx(encTxFrame, size);
+
+    // status vector: byte count, done, then total bytes on the wire
+    for (i = 0; i < 7; i++)
+        encMemory[(end + 1 + i) & 0x1FFF] = 0;
+    encMemory[(end + 1) & 0x1FFF] = (size + 4) & 0xFF;
+    encMemory[(end + 2) & 0x1FFF] = (size + 4) >> 8;
+    encMemory[(end + 3) & 0x1FFF] = 0x80;
+    encMemory[(end + 5) & 0x1FFF] = (size + 4) & 0xFF;
+    encMemory[(end + 6) & 0x1FFF] = (size + 4) >> 8;
+
+    *encRegister(ECON1) &= ~TXRTS;
+    *encRegister(EIR) |= TXIF;
+}
+
+void encWriteRegister(uint8_t reg, uint8_t value)
+{
+    uint8_t old = *encRegister(reg);
+    uint8_t address;
+    uint16_t data;
+
+    switch (reg)
+    {
+        case EPKTCNT:
+        case MISTAT:
+        case EREVID:
+            return;
+        case EIR:
+            value &= ~PKTIF;
+            break;
+        case ECON2:
+            if ((value & PKTDEC) && *encRegister(EPKTCNT) > 0)
+                (*encRegister(EPKTCNT))--;
+            value &= ~PKTDEC;
+            break;
+    }
+    *encRegister(reg) = value;
+
+    switch (reg)
+    {
+        case ECON1:
+            if ((value & TXRTS) && !(old & TXRTS))
+                encTransmit();
+            // clearing TXRTS aborts the frame being sent
+            if (!(value & TXRTS) && (old & TXRTS))
+                encTxPending = false;
+            break;
+        case MICMD:
+            if (value & MIIRD)
+            {
+                address = *encRegister(MIREGADR) & 0x1F;
+                data = encReadPhy(address);
+                *encRegister(MIRDL) = data & 0xFF;
+                *encRegister(MIRDH) = data >> 8;
+                // reading PHIR acknowledges the link change
+                if (address == PHIR)
+                {
+                    encPhy[PHIR] = 0;
+                    *encRegister(EIR) &= ~LINKIF;
+                }
+            }
+            break;
+        case MIWRH:
+            address = *encRegister(MIREGADR) & 0x1F;
+            if (address != PHSTAT1 && address != PHSTAT2 && address != PHIR)
+                encPhy[address] = *encRegister(MIWRL) | (value << 8);
+            break;
+    }
+}
+
+uint8_t encReadBuffer()
+{
+    uint16_t pointer = encGet16(ERDPTL);
+    uint8_t data = encMemory[pointer];
+    if (*encRegister(ECON2) & AUTOINC)
+    {
+        // reads wrap inside the receive ring
+        if (pointer == encGet16(ERXNDL))
+            pointer = encGet16(ERXSTL);
+        else
+            pointer = (pointer + 1) & 0x1FFF;
+        encSet16(ERDPTL, pointer);
+    }
+    return data;
+}
+
+void encWriteBuffer(uint8_t data)
+{
+    uint16_t pointer = encGet16(EWRPTL);
+    encMemory[pointer] = data;
+    if (*encRegister(ECON2) & AUTOINC)
+        encSet16(EWRPTL, (pointer + 1) & 0x1FFF);
+}
+
+// Chip select, an instruction starts with the first byte after selection
+void encSelect(bool selected)
+{
+    encSelected = selected;
+    encBytes = 0;
+}
+
+// Exchanges one byte over spi
+// Returns the byte shifted out by the controller
+uint8_t encTransfer(uint8_t data)
+{
+    uint8_t reg;
+    if (!encSelected)
+        return 0xFF;
+    if (encBytes++ == 0)
+    {
+        encOpcode = data;
+        if (data == SRC)
+            encReset();
+        return 0;
+    }
+    reg = ((*encRegister(ECON1) & 0x03) << 5) | (encOpcode & 0x1F);
+    if ((encOpcode & 0x1F) >= EIE)
+        reg = encOpcode & 0x1F;
+    switch (encOpcode >> 5)
+    {
+        case RCR:
+            return encReadRegister(reg);
+        case RBM:
+            return encReadBuffer();
+        case WCR:
+            if (encBytes == 2)
+                encWriteRegister(reg, data);
+            break;
+        case WBM:
+            encWriteBuffer(data);
+            break;
+        case BFS:
+            if (encBytes == 2)
+                encWriteRegister(reg, *encRegister(reg) | data);
+            break;
+        case BFC:
+            if (encBytes == 2)
+                encWriteRegister(reg, *encRegister(reg) & ~data);
+            break;
+    }
+    return 0;
+}
+
+// Checksum over the pattern match window bytes selected by EPMM
+uint16_t encPatternChecksum(const uint8_t frame[], uint16_t size)
+{
+    uint16_t offset = encGet16(EPMOL) & 0x07FF;
+    uint32_t sum = 0;
+    uint8_t selected = 0;
+    uint8_t i;
+    for (i = 0; i < 64; i++)
+    {
+        if ((*encRegister(EPMM0 + i / 8) & (1 << (i % 8))) == 0)
+            continue;
+        if (offset + i < size)
+            sum += (selected & 1) ? frame[offset + i] : (frame[offset + i] << 8);
+        selected++;
+    }
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+// Wake-on-lan magic packet: 6 x 0xFF then the destination mac 16 times
+bool encIsMagicPacket(const uint8_t frame[], uint16_t size, const uint8_t mac[6])
+{
+    uint16_t i, j;
+    for (i = 14; i + 102 <= size; i++)
+    {
+        for (j = 0; j < 6 && frame[i + j] == 0xFF; j++);
+        if (j < 6)
+            continue;
+        for (j = 0; j < 96 && frame[i + 6 + j] == mac[j % 6]; j++);
+        if (j == 96)
+            return true;
+    }
+    return false;
+}
+
+// Applies the receive filters in ERXFCON
+bool encAcceptFrame(const uint8_t frame[], uint16_t size)
+{
+    uint8_t filters = *encRegister(ERXFCON);
+    uint8_t enabled = filters & (UCEN | PMEN | MPEN | HTEN | MCEN | BCEN);
+    uint8_t matched = 0;
+    uint8_t mac[6];
+    bool broadcast;
+    uint8_t hash;
+
+    if (enabled == 0)
+        return true;
+    mac[0] = *encRegister(MAADR1);
+    mac[1] = *encRegister(MAADR2);
+    mac[2] = *encRegister(MAADR3);
+    mac[3] = *encRegister(MAADR4);
+    mac[4] = *encRegister(MAADR5);
+    mac[5] = *encRegister(MAADR6);
+    broadcast = memcmp(frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0;
+
+    if (memcmp(frame, mac, 6) == 0)
+        matched |= UCEN;
+    if (broadcast)
+        matched |= BCEN;
+    if ((frame[0] & 1) && !broadcast)
+        matched |= MCEN;
+    hash = encGetHashIndex(frame);
+    if (*encRegister(EHT0 + hash / 8) & (1 << (hash % 8)))
+        matched |= HTEN;
+    // the window may run into the padding and fcs of a short frame
+    if (encPatternChecksum(frame, size) == encGet16(EPMCSL)
+        && (encGet16(EPMOL) & 0x07FF) + 64 <= (size < 60 ? 60 : size) + 4)
+        matched |= PMEN;
+    if ((matched & (UCEN | BCEN)) && encIsMagicPacket(frame, size, mac))
+        matched |= MPEN;
+
+    if (filters & ANDOR)
+        return (matched & enabled) == enabled;
+    return (matched & enabled) != 0;
+}
+
+uint16_t encRxFree()
+{
+    uint16_t start = encGet16(ERXSTL);
+    uint16_t end = encGet16(ERXNDL);
+    uint16_t write = encGet16(ERXWRPTL);
+    uint16_t read = encGet16(ERXRDPTL);
+    if (write > read)
+        return (end - start) - (write - read);
+    if (write == read)
+        return end - start;
+    return read - write - 1;
+}
+
+void encRxWrite(uint16_t* pointer, uint8_t data)
+{
+    encMemory[*pointer] = data;
+    if (*pointer == encGet16(ERXNDL))
+        *pointer = encGet16(ERXSTL);
+    else
+        *pointer = (*pointer + 1) & 0x1FFF;
+}
+
+// Receives a frame from the wire (without fcs)
+// Writes next packet pointer, status vector, data and fcs into the ring
+// Returns false if the frame was filtered or dropped for lack of space
+bool encInjectFrame(const uint8_t frame[], uint16_t size)
+{
+    uint16_t length = (size < 60 ? 60 : size) + 4;
+    uint16_t pointer = encGet16(ERXWRPTL);
+    uint16_t next;
+    uint32_t fcs;
+    uint8_t padded[60];
+    uint8_t status;
+    uint16_t i;
+
+    if (!encLinkUp || (*encRegister(ECON1) & RXEN) == 0 || size < 14)
+        return false;
+    if (!encAcceptFrame(frame, size)
+        || (length > encGet16(MAMXFLL) && (*encRegister(MACON3) & HFRMEN) == 0))
+    {
+        encRxFiltered++;
+        return false;
+    }
+    if (*encRegister(EPKTCNT) == 255 || 6 + length + 1 > encRxFree())
+    {
+        *encRegister(EIR) |= RXERIF;
+        encRxOverflows++;
+        return false;
+    }
+
+    if (size < 60)
+    {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, frame, size);
+        frame = padded;
+        size = 60;
+    }
+    fcs = encCrc32(frame, size);
+
+    // work out where the next packet starts (always even)
+    next = pointer;
+    for (i = 0; i < 6 + length; i++)
+    {
+        if (next == encGet16(ERXNDL))
+            next = encGet16(ERXSTL);
+        else
+            next++;
+    }
+    if (next & 1)
+        next = (next == encGet16(ERXNDL)) ? encGet16(ERXSTL) : next + 1;
+
+    status = 0;
+    if (frame[0] & 1)
+        status = memcmp(frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0 ? 0x02 : 0x01;
+    encRxWrite(&pointer, next & 0xFF);
+    encRxWrite(&pointer, next >> 8);
+    encRxWrite(&pointer, length & 0xFF);
+    encRxWrite(&pointer, length >> 8);
+    encRxWrite(&pointer, 0x80);             // received ok
+    encRxWrite(&pointer, status);
+    for (i = 0; i < size; i++)
+        encRxWrite(&pointer, frame[i]);
+    for (i = 0; i < 4; i++)
+        encRxWrite(&pointer, (fcs >> (i * 8)) & 0xFF);
+
+    encSet16(ERXWRPTL, next);
+    (*encRegister(EPKTCNT))++;
+    simUpdateGpio();
+    return true;
+}
+
+void encSetTxHandler(encTxHandler handler)
+{
+    encTx = handler;
+}
+
+void encSetLink(bool up)
+{
+    if (up != encLinkUp)
+    {
+        encPhy[PHIR] |= PLNKIF;
+        if ((encPhy[PHIE] & (PLNKIE | PGEIE)) == (PLNKIE | PGEIE))
+            *encRegister(EIR) |= LINKIF;
+    }
+    encLinkUp = up;
+}
+
+// INT is active low and asserted while an enabled flag is set
+bool encIsInterruptAsserted()
+{
+    uint8_t eie = *encRegister(EIE);
+    return (eie & INTIE) && (eie & encReadRegister(EIR) & 0x7B);
+}
+
+uint8_t encGetPacketCount()
+{
+    return *encRegister(EPKTCNT);
+}
@@ -0,0 +1,57 @@
+// ENC28J60 Model
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Software model of the controller as seen over SPI: control register banks,
+// 8 KB buffer memory, the receive ring with EPKTCNT, transmit with the status
+// vector, the receive filters, MII access to the phy and the INT pin.
+// Frames reach the model with encInjectFrame and leave through the transmit
+// handler. Transmit holds TXRTS for the frame's time on the wire while
+// virtual time runs on, so the firmware can work meanwhile. MAC and MII register reads return data on the first byte (the
+// dummy byte sent by the real part is not modeled).
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ENC28J60_H_
+#define ENC28J60_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+#define ENC_MEMORY_SIZE 8192
+
+// Time on the wire at 10 Mb/s with preamble, fcs and inter-frame gap
+#define ENC_WIRE_CYCLES(size) (((size) + 24) * 8 * (SIM_CLOCK / 10000000))
+
+// Called with each frame transmitted (no fcs, padded to 60 bytes if enabled)
+typedef void (*encTxHandler)(const uint8_t frame[], uint16_t size);
+
+// Frames refused by the receive filters or for lack of ring space
+extern uint32_t encRxFiltered;
+extern uint32_t encRxOverflows;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void encReset();
+void encSelect(bool selected);
+uint8_t encTransfer(uint8_t data);
+void encUpdate();
+bool encInjectFrame(const uint8_t frame[], uint16_t size);
+void encSetTxHandler(encTxHandler handler);
+void encSetLink(bool up);
+bool encIsInterruptAsserted();
+uint8_t encGetPacketCount();
+uint8_t encGetHashIndex(const uint8_t mac[6]);
+
+#endif
@@ -0,0 +1,151 @@
+// GPIO Library (host)
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Pins keep their last written value. PA3 is the ENC28J60 chip select,
+// either as a gpio or, with its aux function enabled, as SSI0Fss (see
+// spi0.c), and PC6 reads back the (active low) ENC28J60 interrupt line. While its pin
+// interrupt is enabled the line runs etherIsr as a low level interrupt would.
+// Other pin configuration calls have no effect.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio.h"
+#include "enc28j60.h"
+#include "eth0.h"
+#include "sim.h"
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+uint8_t portValues[6];
+uint8_t portInterrupts[6];
+uint8_t portAux[6];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t getPortIndex(PORT port)
+{
+    switch (port)
+    {
+        case PORTA: return 0;
+        case PORTB: return 1;
+        case PORTC: return 2;
+        case PORTD: return 3;
+        case PORTE: return 4;
+        default:    return 5;
+    }
+}
+
+void enablePort(PORT port) {}
+void disablePort(PORT port) {}
+
+void selectPinPushPullOutput(PORT port, uint8_t pin) {}
+void selectPinOpenDrainOutput(PORT port, uint8_t pin) {}
+void selectPinDigitalInput(PORT port, uint8_t pin) {}
+void selectPinAnalogInput(PORT port, uint8_t pin) {}
+void setPinCommitControl(PORT port, uint8_t pin) {}
+
+// An input with a pull-up reads high until something drives it
+void enablePinPullup(PORT port, uint8_t pin)
+{
+    portValues[getPortIndex(port)] |= 1 << pin;
+}
+
+void disablePinPullup(PORT port, uint8_t pin) {}
+void enablePinPulldown(PORT port, uint8_t pin) {}
+void disablePinPulldown(PORT port, uint8_t pin) {}
+
+void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn) {}
+
+// SSI0Fss idles high, as a gpio PA3 drives its data bit
+void enablePinAuxFunction(PORT port, uint8_t pin)
+{
+    portAux[getPortIndex(port)] |= 1 << pin;
+    if (port == PORTA && pin == 3)
+        encSelect(false);
+}
+
+void disablePinAuxFunction(PORT port, uint8_t pin)
+{
+    portAux[getPortIndex(port)] &= ~(1 << pin);
+    if (port == PORTA && pin == 3)
+        encSelect(!(portValues[0] & (1 << 3)));
+}
+
+bool simIsSpi0FssEnabled()
+{
+    return (portAux[0] & (1 << 3)) != 0;
+}
+
+void selectPinInterruptRisingEdge(PORT port, uint8_t pin) {}
+void selectPinInterruptFallingEdge(PORT port, uint8_t pin) {}
+void selectPinInterruptBothEdges(PORT port, uint8_t pin) {}
+void selectPinInterruptHighLevel(PORT port, uint8_t pin) {}
+void selectPinInterruptLowLevel(PORT port, uint8_t pin) {}
+
+void enablePinInterrupt(PORT port, uint8_t pin)
+{
+    portInterrupts[getPortIndex(port)] |= 1 << pin;
+    simUpdateGpio();
+}
+
+void disablePinInterrupt(PORT port, uint8_t pin)
+{
+    portInterrupts[getPortIndex(port)] &= ~(1 << pin);
+}
+
+// Runs the isr while the ENC28J60 line is low and its interrupt enabled
+// Called when time moves, a frame arrives or the interrupt is enabled
+void simUpdateGpio()
+{
+    if ((portInterrupts[2] & (1 << 6)) && encIsInterruptAsserted())
+        etherIsr();
+}
+
+void setPinValue(PORT port, uint8_t pin, bool value)
+{
+    uint8_t index = getPortIndex(port);
+    if (value)
+        portValues[index] |= 1 << pin;
+    else
+        portValues[index] &= ~(1 << pin);
+    if (port == PORTA && pin == 3 && !simIsSpi0FssEnabled())
+        encSelect(!value);
+}
+
+bool getPinValue(PORT port, uint8_t pin)
+{
+    if (port == PORTC && pin == 6)
+        return !encIsInterruptAsserted();
+    return (portValues[getPortIndex(port)] >> pin) & 1;
+}
+
+void setPortValue(PORT port, uint8_t value)
+{
+    uint8_t pin;
+    for (pin = 0; pin < 8; pin++)
+        setPinValue(port, pin, (value >> pin) & 1);
+}
+
+uint8_t getPortValue(PORT port)
+{
+    uint8_t value = 0;
+    uint8_t pin;
+    for (pin = 0; pin < 8; pin++)
+        value |= getPinValue(port, pin) << pin;
+    return value;
+}
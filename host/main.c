@@ -0,0 +1,78 @@
+// Host Entry Point
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Runs the firmware main loop against the ENC28J60 model with virtual time
+// kept in step with the wall clock. The console is stdin/stdout and every
+// transmitted frame is listed on stderr.
+//
+// Usage: ethernet [-e EEPROM_IMAGE]
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "enc28j60.h"
+#include "sim.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint64_t getWallCycles()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * SIM_CLOCK + (uint64_t)now.tv_nsec * (SIM_CLOCK / 1000000) / 1000;
+}
+
+void listFrame(const uint8_t frame[], uint16_t size)
+{
+    fprintf(stderr, "tx %4u bytes type %02x%02x to %02x:%02x:%02x:%02x:%02x:%02x\n",
+            size, frame[12], frame[13], frame[0], frame[1], frame[2], frame[3], frame[4], frame[5]);
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t start, wall;
+    int option;
+
+    while ((option = getopt(argc, argv, "e:")) != -1)
+    {
+        if (option == 'e')
+            simSetEepromFile(optarg);
+        else
+        {
+            fprintf(stderr, "usage: %s [-e EEPROM_IMAGE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    initSim();
+    encSetTxHandler(listFrame);
+    simEnableStdin(true);
+    initApp();
+
+    start = getWallCycles() - simGetCycles();
+    while (true)
+    {
+        pollApp();
+        wall = getWallCycles() - start;
+        if (wall > simGetCycles())
+            simAdvance(wall - simGetCycles());
+        else
+            usleep(1000);
+    }
+}
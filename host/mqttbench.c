@@ -0,0 +1,301 @@
+// MQTT Publish Benchmark
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Runs the firmware against the broker stub on virtual time and reports
+// messages/s, p50/p99 latency and frames per message for each mode,
+// payload size and QoS level. Messages are sent one at a time, the next
+// starting once the previous one has been acknowledged.
+//
+//   session  the pub command: connect, publish, disconnect per message
+//            (latency is until the broker has the publish)
+//   publish  publishMqttMessage on an open session
+//            (latency is until the broker has the publish)
+//   deliver  broker to device on the subscribed session
+//            (latency is until the broker has the device's ack)
+//
+// Usage: mqttbench [-n COUNT] [-s SIZE,...] [-q QOS,...] [-m MODE,...] [-t TURNAROUND_US]
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "eth0.h"
+#include "shell.h"
+#include "enc28j60.h"
+#include "broker.h"
+#include "sim.h"
+
+#define CYCLES_PER_US   (SIM_CLOCK / 1000000)
+#define MAX_MESSAGES    10000
+#define MAX_SIZES       16
+#define MAX_PAYLOAD     1200
+#define TIMEOUT_US      5000000
+
+#define BENCH_TOPIC_OUT "bench/out"
+#define BENCH_TOPIC_IN  "bench/in"
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+extern uint8_t publishFlag;
+extern uint8_t subscribeFlag;
+extern TCPState NextState;
+extern char mqttTopic[MQTT_TOPIC_SIZE];
+extern char mqttMessage[MQTT_MESSAGE_SIZE];
+
+uint32_t deviceFrames = 0;
+bool published = false;
+uint64_t publishedAt = 0;
+uint64_t latencies[MAX_MESSAGES];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void deviceTransmit(const uint8_t frame[], uint16_t size)
+{
+    deviceFrames++;
+    brokerReceive(frame, size);
+}
+
+void onPublish(const char topic[], const uint8_t payload[], uint16_t size, uint8_t qos, uint64_t cycles)
+{
+    if (strcmp(topic, BENCH_TOPIC_OUT) == 0)
+    {
+        published = true;
+        publishedAt = cycles;
+    }
+}
+
+// Nothing in flight in either direction
+bool isQuiet()
+{
+    return brokerIsAcked() && encGetPacketCount() == 0;
+}
+
+bool isSessionDone()
+{
+    return published && publishFlag == 0 && NextState == closed && isQuiet();
+}
+
+bool isPublishDone()
+{
+    return published && isQuiet();
+}
+
+bool isSubscribed()
+{
+    return NextState == subAck && broker.subscribes > 0 && isQuiet();
+}
+
+// Runs the main loop with the broker attached until done() or timeout
+bool runUntil(bool (*done)(), uint32_t timeoutUs)
+{
+    uint64_t end = simGetCycles() + (uint64_t)timeoutUs * CYCLES_PER_US;
+    uint64_t start;
+    while (!done())
+    {
+        if (simGetCycles() >= end)
+            return false;
+        brokerPoll();
+        start = simGetCycles();
+        pollApp();
+        if (simGetCycles() == start)
+            simAdvance(CYCLES_PER_US);
+    }
+    return true;
+}
+
+int compareLatency(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Sends count messages of size bytes in the given mode
+// Returns false if a message was not completed in time
+bool runMode(const char mode[], uint16_t size, uint32_t count)
+{
+    static uint8_t payload[MAX_PAYLOAD];
+    uint32_t i, frames;
+    uint64_t start, sent;
+    bool ok = true;
+
+    memset(payload, 'x', sizeof(payload));
+    frames = deviceFrames + broker.framesTx;
+    start = simGetCycles();
+    for (i = 0; i < count && ok; i++)
+    {
+        published = false;
+        sent = simGetCycles();
+        if (strcmp(mode, "session") == 0)
+        {
+            // same as the pub command
+            strcpy(mqttTopic, BENCH_TOPIC_OUT);
+            memcpy(mqttMessage, payload, size);
+            mqttMessage[size] = 0;
+            publishFlag = 1;
+            NextState = closed;
+            ok = runUntil(isSessionDone, TIMEOUT_US);
+            latencies[i] = publishedAt - sent;
+        }
+        else if (strcmp(mode, "publish") == 0)
+        {
+            ok = publishMqttMessage(BENCH_TOPIC_OUT, payload, size) && runUntil(isPublishDone, TIMEOUT_US);
+            latencies[i] = publishedAt - sent;
+        }
+        else
+        {
+            ok = brokerPublish(BENCH_TOPIC_IN, payload, size) > 0 && runUntil(brokerIsAcked, TIMEOUT_US);
+            latencies[i] = simGetCycles() - sent;
+            runUntil(isQuiet, TIMEOUT_US);
+        }
+    }
+    if (!ok)
+    {
+        printf("%-8s %4u %6u  stalled at message %u\n", mode, 0, size, i);
+        return false;
+    }
+
+    qsort(latencies, count, sizeof(uint64_t), compareLatency);
+    printf("%-8s %4u %6u %6u %10.1f %10.1f %10.1f %10.2f\n", mode, 0, size, count,
+           (double)count * SIM_CLOCK / (simGetCycles() - start),
+           (double)latencies[count / 2] / CYCLES_PER_US,
+           (double)latencies[(count * 99) / 100] / CYCLES_PER_US,
+           (double)(deviceFrames + broker.framesTx - frames) / count);
+    return true;
+}
+
+// Splits a comma separated list of numbers
+uint8_t parseList(char list[], uint32_t values[], uint8_t maxCount)
+{
+    uint8_t count = 0;
+    char* token = strtok(list, ",");
+    while (token != NULL && count < maxCount)
+    {
+        values[count++] = atoi(token);
+        token = strtok(NULL, ",");
+    }
+    return count;
+}
+
+void usage(const char name[])
+{
+    fprintf(stderr, "usage: %s [-n COUNT] [-s SIZE,...] [-q QOS,...] [-m MODE,...] [-t TURNAROUND_US]\n", name);
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    char defaultSizes[] = "16,64,256,1024";
+    char defaultQos[] = "0";
+    char defaultModes[] = "session,publish,deliver";
+    char* sizeList = defaultSizes;
+    char* qosList = defaultQos;
+    char* modeList = defaultModes;
+    const char* modes[3] = {"session", "publish", "deliver"};
+    bool enabled[3] = {false, false, false};
+    uint32_t sizes[MAX_SIZES], levels[3];
+    uint8_t sizeCount, levelCount, i, j, k;
+    uint32_t count = 100, turnaroundUs = 50;
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+    uint8_t ip[4];
+    char* token;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:s:q:m:t:")) != -1)
+    {
+        switch (option)
+        {
+            case 'n': count = atoi(optarg); break;
+            case 's': sizeList = optarg; break;
+            case 'q': qosList = optarg; break;
+            case 'm': modeList = optarg; break;
+            case 't': turnaroundUs = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (count == 0 || count > MAX_MESSAGES)
+        usage(argv[0]);
+    sizeCount = parseList(sizeList, sizes, MAX_SIZES);
+    levelCount = parseList(qosList, levels, 3);
+    // sessions run first, the other modes share one subscribed session
+    for (token = strtok(modeList, ","); token != NULL; token = strtok(NULL, ","))
+    {
+        for (i = 0; i < 3 && strcmp(token, modes[i]) != 0; i++);
+        if (i == 3)
+            usage(argv[0]);
+        enabled[i] = true;
+    }
+
+    initSim();
+    simEnableConsole(false);
+    initApp();
+    etherGetMqttBrokerAddress(ip);
+    initBroker(mac, ip, turnaroundUs * CYCLES_PER_US);
+    brokerSetPublishHandler(onPublish);
+    encSetTxHandler(deviceTransmit);
+
+    printf("%-8s %4s %6s %6s %10s %10s %10s %10s\n", "mode", "qos", "size", "msgs", "msgs/s",
+           "p50_us", "p99_us", "frames/msg");
+    for (k = 0; k < levelCount; k++)
+    {
+        // the firmware client only publishes and subscribes at QoS 0
+        if (levels[k] != 0)
+        {
+            printf("qos %u: not supported by the firmware client\n", levels[k]);
+            continue;
+        }
+        for (i = 0; i < 3; i++)
+        {
+            if (!enabled[i])
+                continue;
+            if (i > 0)
+            {
+                if (NextState != subAck)
+                {
+                    strcpy(mqttTopic, BENCH_TOPIC_IN);
+                    subscribeFlag = 1;
+                    NextState = closed;
+                    if (!runUntil(isSubscribed, TIMEOUT_US))
+                    {
+                        printf("could not subscribe\n");
+                        return 1;
+                    }
+                }
+            }
+            for (j = 0; j < sizeCount; j++)
+            {
+                if (i == 0 && sizes[j] >= MQTT_MESSAGE_SIZE)
+                {
+                    printf("%-8s %4u %6u  larger than the pub command allows\n", modes[i], 0, sizes[j]);
+                    continue;
+                }
+                if (sizes[j] > MAX_PAYLOAD)
+                {
+                    printf("%-8s %4u %6u  larger than a segment\n", modes[i], 0, sizes[j]);
+                    continue;
+                }
+                runMode(modes[i], sizes[j], count);
+            }
+        }
+    }
+    printf("\nbroker: %u frames in, %u out, %u lost, %u checksum errors\n",
+           broker.framesRx, broker.framesTx, broker.framesLost, broker.checksumErrors);
+    return 0;
+}
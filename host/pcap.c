@@ -0,0 +1,123 @@
+// pcap File Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "pcap.h"
+
+#define PCAP_MAGIC      0xA1B2C3D4
+#define PCAP_MAGIC_NS   0xA1B23C4D
+#define LINKTYPE_ETHERNET 1
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint32_t pcapSwap32(uint32_t x)
+{
+    return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+bool pcapReadWords(pcapFile* pcap, uint32_t words[], uint8_t count)
+{
+    uint8_t i;
+    if (fread(words, sizeof(uint32_t), count, pcap->file) != count)
+        return false;
+    if (pcap->swapped)
+    {
+        for (i = 0; i < count; i++)
+            words[i] = pcapSwap32(words[i]);
+    }
+    return true;
+}
+
+// Opens a capture and checks the header
+// Returns false if the file cannot be read or is not an ethernet capture
+bool pcapOpenRead(pcapFile* pcap, const char name[])
+{
+    uint32_t header[6];
+    pcap->swapped = false;
+    pcap->file = fopen(name, "rb");
+    if (pcap->file == NULL)
+        return false;
+    if (!pcapReadWords(pcap, header, 6))
+    {
+        pcapClose(pcap);
+        return false;
+    }
+    if (header[0] == pcapSwap32(PCAP_MAGIC) || header[0] == pcapSwap32(PCAP_MAGIC_NS))
+    {
+        pcap->swapped = true;
+        header[0] = pcapSwap32(header[0]);
+        header[5] = pcapSwap32(header[5]);
+    }
+    pcap->nanoseconds = header[0] == PCAP_MAGIC_NS;
+    if ((header[0] != PCAP_MAGIC && header[0] != PCAP_MAGIC_NS) || (header[5] & 0xFFFF) != LINKTYPE_ETHERNET)
+    {
+        pcapClose(pcap);
+        return false;
+    }
+    return true;
+}
+
+bool pcapOpenWrite(pcapFile* pcap, const char name[])
+{
+    // version 2.4, utc, no accuracy, snaplen, ethernet
+    uint32_t header[6] = {PCAP_MAGIC, 0x00040002, 0, 0, PCAP_SNAPLEN, LINKTYPE_ETHERNET};
+    pcap->swapped = false;
+    pcap->nanoseconds = false;
+    pcap->file = fopen(name, "wb");
+    if (pcap->file == NULL)
+        return false;
+    fwrite(header, sizeof(header), 1, pcap->file);
+    return true;
+}
+
+// Reads the next frame and its timestamp in microseconds
+// Frames longer than maxSize are truncated
+// Returns the frame size or -1 at the end of the file
+int32_t pcapRead(pcapFile* pcap, uint64_t* time, uint8_t frame[], uint16_t maxSize)
+{
+    uint32_t record[4];
+    uint32_t size, kept;
+    if (!pcapReadWords(pcap, record, 4))
+        return -1;
+    *time = (uint64_t)record[0] * 1000000 + (pcap->nanoseconds ? record[1] / 1000 : record[1]);
+    size = record[2];
+    kept = size < maxSize ? size : maxSize;
+    if (fread(frame, 1, kept, pcap->file) != kept)
+        return -1;
+    if (size > kept)
+        fseek(pcap->file, size - kept, SEEK_CUR);
+    return kept;
+}
+
+void pcapWrite(pcapFile* pcap, uint64_t time, const uint8_t frame[], uint16_t size)
+{
+    uint32_t record[4];
+    record[0] = time / 1000000;
+    record[1] = time % 1000000;
+    record[2] = size;
+    record[3] = size;
+    fwrite(record, sizeof(record), 1, pcap->file);
+    fwrite(frame, 1, size, pcap->file);
+}
+
+void pcapClose(pcapFile* pcap)
+{
+    if (pcap->file != NULL)
+        fclose(pcap->file);
+    pcap->file = NULL;
+}
@@ -0,0 +1,44 @@
+// pcap File Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    -
+
+// Classic libpcap files with ethernet link type. Reads either byte order
+// and microsecond or nanosecond timestamps, writes microsecond files.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PCAP_H_
+#define PCAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define PCAP_SNAPLEN 1522
+
+typedef struct _pcapFile
+{
+  FILE* file;
+  bool swapped;
+  bool nanoseconds;
+} pcapFile;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool pcapOpenRead(pcapFile* pcap, const char name[]);
+bool pcapOpenWrite(pcapFile* pcap, const char name[]);
+int32_t pcapRead(pcapFile* pcap, uint64_t* time, uint8_t frame[], uint16_t maxSize);
+void pcapWrite(pcapFile* pcap, uint64_t time, const uint8_t frame[], uint16_t size);
+void pcapClose(pcapFile* pcap);
+
+#endif
@@ -0,0 +1,278 @@
+// pcap Replay Harness
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Feeds the frames of a capture into the ENC28J60 model at their recorded
+// times (or back to back with -f) while the firmware main loop runs on
+// virtual time, and writes every transmitted frame to an output capture.
+//
+// Each pass of the main loop that takes a frame out of the receive ring is
+// charged to that frame. Its cost is the virtual cycles spent in the pass
+// (SPI transfers and waits, as on the target) and its latency is the time
+// from arrival on the wire to the end of the pass. Frames that arrive while
+// the ring is full are dropped as on the controller.
+//
+// Usage: replay [-f] [-v] [-c] [-o OUTPUT] [-e EEPROM_IMAGE] [-t TAIL_MS] INPUT
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "enc28j60.h"
+#include "pcap.h"
+#include "sim.h"
+
+#define CYCLES_PER_US (SIM_CLOCK / 1000000)
+#define IDLE_STEP_US  1000
+
+// Frames in the receive ring (EPKTCNT is at most 255)
+#define PENDING_SIZE  256
+
+#define CLASS_ARP   0
+#define CLASS_ICMP  1
+#define CLASS_TCP   2
+#define CLASS_UDP   3
+#define CLASS_OTHER 4
+#define CLASS_COUNT 5
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _pendingFrame
+{
+  uint32_t index;
+  uint64_t arrival;      // us
+  uint16_t size;
+  uint8_t class;
+} pendingFrame;
+
+typedef struct _costStats
+{
+  uint32_t count;
+  uint64_t cycles;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint64_t latency;
+  uint64_t maxLatency;
+} costStats;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+const char* className[CLASS_COUNT] = {"arp", "icmp", "tcp", "udp", "other"};
+
+pendingFrame pending[PENDING_SIZE];
+uint16_t pendingHead = 0;
+uint16_t pendingTail = 0;
+
+costStats classStats[CLASS_COUNT];
+costStats totalStats;
+
+pcapFile output;
+bool writeOutput = false;
+uint32_t txFrames = 0;
+uint64_t timeBase = 0;
+uint64_t cycleBase = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Virtual time in us on the input capture's clock
+uint64_t getTime()
+{
+    return timeBase + (simGetCycles() - cycleBase) / CYCLES_PER_US;
+}
+
+uint8_t getClass(const uint8_t frame[], uint16_t size)
+{
+    uint16_t type = (frame[12] << 8) | frame[13];
+    if (type == 0x0806)
+        return CLASS_ARP;
+    if (type == 0x0800 && size > 23)
+    {
+        switch (frame[23])
+        {
+            case 1:  return CLASS_ICMP;
+            case 6:  return CLASS_TCP;
+            case 17: return CLASS_UDP;
+        }
+    }
+    return CLASS_OTHER;
+}
+
+void captureFrame(const uint8_t frame[], uint16_t size)
+{
+    txFrames++;
+    if (writeOutput)
+        pcapWrite(&output, getTime(), frame, size);
+}
+
+void addCost(costStats* stats, uint32_t cycles, uint64_t latency)
+{
+    if (stats->count == 0 || cycles < stats->minCycles)
+        stats->minCycles = cycles;
+    if (cycles > stats->maxCycles)
+        stats->maxCycles = cycles;
+    if (latency > stats->maxLatency)
+        stats->maxLatency = latency;
+    stats->count++;
+    stats->cycles += cycles;
+    stats->latency += latency;
+}
+
+void printCost(const char name[], const costStats* stats)
+{
+    if (stats->count == 0)
+        return;
+    printf("%-6s %8u %10u %10llu %10u %10llu %10llu\n", name, stats->count, stats->minCycles,
+           (unsigned long long)(stats->cycles / stats->count), stats->maxCycles,
+           (unsigned long long)(stats->latency / stats->count), (unsigned long long)stats->maxLatency);
+}
+
+void usage(const char name[])
+{
+    fprintf(stderr, "usage: %s [-f] [-v] [-c] [-o OUTPUT] [-e EEPROM_IMAGE] [-t TAIL_MS] INPUT\n", name);
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    pcapFile input;
+    uint8_t frame[PCAP_SNAPLEN];
+    int32_t size;
+    uint64_t nextTime = 0, endTime = 0, target, start, now;
+    uint32_t framesIn = 0, delivered = 0, tailMs = 1000, txBefore, cycles;
+    bool fast = false, verbose = false, console = false;
+    uint8_t count, i;
+    pendingFrame* done;
+    int option;
+
+    while ((option = getopt(argc, argv, "fvco:e:t:")) != -1)
+    {
+        switch (option)
+        {
+            case 'f': fast = true; break;
+            case 'v': verbose = true; break;
+            case 'c': console = true; break;
+            case 'e': simSetEepromFile(optarg); break;
+            case 't': tailMs = atoi(optarg); break;
+            case 'o':
+                if (!pcapOpenWrite(&output, optarg))
+                {
+                    fprintf(stderr, "cannot create %s\n", optarg);
+                    return 1;
+                }
+                writeOutput = true;
+                break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+    if (!pcapOpenRead(&input, argv[optind]))
+    {
+        fprintf(stderr, "cannot read ethernet capture %s\n", argv[optind]);
+        return 1;
+    }
+
+    // boot the firmware, then line virtual time up with the first frame
+    initSim();
+    simEnableConsole(console);
+    initApp();
+    encSetTxHandler(captureFrame);
+    size = pcapRead(&input, &nextTime, frame, sizeof(frame));
+    timeBase = size >= 0 ? nextTime : 0;
+    cycleBase = simGetCycles();
+
+    if (verbose)
+        printf("%8s %12s %6s %-6s %10s %10s %4s\n", "frame", "time_us", "size", "class", "cycles", "latency_us", "tx");
+
+    while (true)
+    {
+        // frames that are on the wire by now
+        while (size >= 0 && (fast ? pendingHead == pendingTail : nextTime <= getTime()))
+        {
+            framesIn++;
+            if (encInjectFrame(frame, size))
+            {
+                pending[pendingHead].index = framesIn;
+                pending[pendingHead].arrival = fast ? getTime() : nextTime;
+                pending[pendingHead].size = size;
+                pending[pendingHead].class = getClass(frame, size);
+                pendingHead = (pendingHead + 1) % PENDING_SIZE;
+                delivered++;
+            }
+            size = pcapRead(&input, &nextTime, frame, sizeof(frame));
+            if (size < 0)
+                endTime = (fast ? getTime() : nextTime) + (uint64_t)tailMs * 1000;
+        }
+        if (size < 0 && pendingHead == pendingTail && getTime() >= endTime)
+            break;
+
+        // one pass of the main loop
+        count = encGetPacketCount();
+        txBefore = txFrames;
+        start = simGetCycles();
+        pollApp();
+        cycles = simGetCycles() - start;
+
+        if (encGetPacketCount() < count && pendingHead != pendingTail)
+        {
+            done = &pending[pendingTail];
+            pendingTail = (pendingTail + 1) % PENDING_SIZE;
+            now = getTime();
+            addCost(&classStats[done->class], cycles, now - done->arrival);
+            addCost(&totalStats, cycles, now - done->arrival);
+            if (verbose)
+                printf("%8u %12llu %6u %-6s %10u %10llu %4u\n", done->index,
+                       (unsigned long long)done->arrival, done->size, className[done->class],
+                       cycles, (unsigned long long)(now - done->arrival), txFrames - txBefore);
+        }
+        else if (pendingHead == pendingTail)
+        {
+            // idle, move time on to the next arrival in small steps so the
+            // firmware's own timers still run
+            now = getTime();
+            target = size >= 0 ? nextTime : endTime;
+            if (target > now + IDLE_STEP_US)
+                target = now + IDLE_STEP_US;
+            if (target > now)
+                simAdvance((target - now) * CYCLES_PER_US);
+        }
+    }
+
+    printf("frames in     %10u\n", framesIn);
+    printf("  received    %10u\n", delivered);
+    printf("  filtered    %10u\n", encRxFiltered);
+    printf("  overflowed  %10u\n", encRxOverflows);
+    printf("frames out    %10u\n", txFrames);
+    printf("virtual time  %10llu us\n", (unsigned long long)(getTime() - timeBase));
+    printf("\n%-6s %8s %10s %10s %10s %10s %10s\n", "class", "frames", "min_cyc", "avg_cyc", "max_cyc",
+           "avg_lat_us", "max_lat_us");
+    for (i = 0; i < CLASS_COUNT; i++)
+        printCost(className[i], &classStats[i]);
+    printCost("all", &totalStats);
+    if (totalStats.cycles != 0)
+        printf("\nthroughput    %10llu frames/s at %u MHz\n",
+               (unsigned long long)((uint64_t)totalStats.count * SIM_CLOCK / totalStats.cycles), SIM_CLOCK / 1000000);
+
+    pcapClose(&input);
+    if (writeOutput)
+        pcapClose(&output);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Host Simulation Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "tm4c123gh6pm.h"
+#include "perf.h"
+#include "enc28j60.h"
+#include "timer.h"
+#include "sim.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+// Register windows backed by memory
+// Peripherals (APB and AHB) and the private peripheral bus (DWT, SysTick, NVIC, SCB)
+#define PERIPHERAL_BASE 0x40000000
+#define PERIPHERAL_SIZE 0x00100000
+#define PPB_BASE        0xE0000000
+#define PPB_SIZE        0x00100000
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+uint64_t simCycles = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void simMap(uintptr_t base, size_t size)
+{
+    void* p = mmap((void*)base, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != (void*)base)
+    {
+        fprintf(stderr, "sim: cannot map registers at 0x%08lx\n", (unsigned long)base);
+        exit(1);
+    }
+}
+
+// Must be called before any firmware code runs
+void initSim()
+{
+    simMap(PERIPHERAL_BASE, PERIPHERAL_SIZE);
+    simMap(PPB_BASE, PPB_SIZE);
+    simCycles = 0;
+    encReset();
+}
+
+// Moves virtual time forward
+// SysTick counts down and interrupts at each reload, timer 1 counts up while
+// enabled and the DWT counter while cycle counting is on
+void simAdvance(uint32_t cycles)
+{
+    uint32_t remaining = cycles;
+    simCycles += cycles;
+    if (NVIC_ST_CTRL_R & NVIC_ST_CTRL_ENABLE)
+    {
+        // current reaches 0 after current cycles and reloads on the next
+        while (remaining > (NVIC_ST_CURRENT_R & NVIC_ST_CURRENT_M))
+        {
+            remaining -= (NVIC_ST_CURRENT_R & NVIC_ST_CURRENT_M) + 1;
+            NVIC_ST_CURRENT_R = NVIC_ST_RELOAD_R & NVIC_ST_RELOAD_M;
+            if (NVIC_ST_CTRL_R & NVIC_ST_CTRL_INTEN)
+                systickIsr();
+        }
+        NVIC_ST_CURRENT_R -= remaining;
+    }
+    if (TIMER1_CTL_R & TIMER_CTL_TAEN)
+        TIMER1_TAV_R += cycles;
+    if (DWT_CTRL_R & DWT_CTRL_CYCCNTENA)
+        DWT_CYCCNT_R += cycles;
+    encUpdate();
+    simUpdateGpio();
+}
+
+uint64_t simGetCycles()
+{
+    return simCycles;
+}
@@ -0,0 +1,63 @@
+// Host Simulation Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// The firmware sources are built unchanged except for clock, spi0, gpio,
+// wait, uart0 and eeprom, which are replaced by the versions in this
+// directory.
+// Peripheral registers used directly (SysTick, DWT, NVIC, sysctl) are backed
+// by plain memory mapped at their TM4C123 addresses, so they read back what
+// was last written. Time only moves when simAdvance is called.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+
+// Virtual time runs at the firmware's clock
+#define SIM_CLOCK SYSTEM_CLOCK
+
+// TI compiler intrinsic
+#define _delay_cycles(cycles) simAdvance(cycles)
+
+// Memory barrier for ring.h
+#define RING_BARRIER() __sync_synchronize()
+
+// No bit-band region, pin access goes through gpio.c
+#define GPIO_NO_BITBAND
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initSim();
+void simAdvance(uint32_t cycles);
+uint64_t simGetCycles();
+
+// Console and eeprom (uart0.c, eeprom.c)
+void simTypeUart0(const char str[]);
+void simEnableStdin(bool enable);
+void simEnableConsole(bool enable);
+void simSetEepromFile(const char file[]);
+
+// Pin interrupts and SSI0Fss (gpio.c)
+void simUpdateGpio();
+bool simIsSpi0FssEnabled();
+
+// Firmware main loop (ethernet.c)
+void initApp();
+void pollApp();
+
+#endif
@@ -0,0 +1,83 @@
+// SPI0 Library (host)
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Each write exchanges a frame of 8 or 16 bits with the ENC28J60 model,
+// which is selected with PA3 (see gpio.c). When PA3 is SSI0Fss the model is
+// selected for each frame, as the SSI does in phase 0. Transfers are charged
+// their bit times at the baud rate.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gpio.h"
+#include "spi0.h"
+#include "enc28j60.h"
+#include "sim.h"
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+uint32_t spi0BitCycles = 10;     // until setSpi0BaudRate
+uint8_t spi0DataSize = 8;
+uint32_t spi0Data = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initSpi0(uint32_t pinMask)
+{
+    if (pinMask & USE_SSI0_FSS)
+        enablePinAuxFunction(PORTA, 3);
+}
+
+// Same even divisor, rounded up, as the SSI
+void setSpi0BaudRate(uint32_t baudRate, uint32_t fcyc)
+{
+    uint32_t divisor = (fcyc + baudRate - 1) / baudRate;
+    divisor = (divisor + 1) & ~1;
+    if (divisor < 2)
+        divisor = 2;
+    spi0BitCycles = divisor;
+}
+
+void setSpi0Mode(uint8_t polarity, uint8_t phase) {}
+
+void setSpi0DataSize(uint8_t bits)
+{
+    spi0DataSize = bits;
+}
+
+// Frames are sent msb first, whole bytes only
+void writeSpi0Data(uint32_t data)
+{
+    bool fss = simIsSpi0FssEnabled();
+    if (fss)
+        encSelect(true);
+    if (spi0DataSize > 8)
+    {
+        spi0Data = encTransfer(data >> 8) << 8;
+        spi0Data |= encTransfer(data & 0xFF);
+    }
+    else
+        spi0Data = encTransfer(data);
+    if (fss)
+        encSelect(false);
+    simAdvance(spi0DataSize * spi0BitCycles);
+}
+
+uint32_t readSpi0Data()
+{
+    return spi0Data;
+}
@@ -0,0 +1,127 @@
+// UART0 Library (host)
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host with simulated ENC28J60
+// Target uC:       -
+// System Clock:    80 MHz (virtual)
+
+// Output goes to stdout and never blocks or drops. Input comes from text
+// queued with simTypeUart0 and then, if enabled, from stdin without waiting.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include "uart0.h"
+#include "sim.h"
+
+#define UART0_TX_RING_SIZE 512
+#define UART0_RX_RING_SIZE 128
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+char uart0RxRing[UART0_RX_RING_SIZE];
+uint8_t uart0RxHead = 0;
+uint8_t uart0RxTail = 0;
+bool uart0Stdin = false;
+bool uart0Output = true;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initUart0() {}
+void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc) {}
+void uart0Isr() {}
+
+bool writeUart0(const char data[], uint16_t size, uint8_t policy)
+{
+    if (uart0Output)
+    {
+        fwrite(data, 1, size, stdout);
+        fflush(stdout);
+    }
+    return true;
+}
+
+void putcUart0(char c)
+{
+    writeUart0(&c, 1, UART0_BLOCK);
+}
+
+void putsUart0(char* str)
+{
+    writeUart0(str, strlen(str), UART0_BLOCK);
+}
+
+bool putsUart0NoWait(char* str)
+{
+    return writeUart0(str, strlen(str), UART0_DROP);
+}
+
+uint16_t getUart0TxFree()
+{
+    return UART0_TX_RING_SIZE - 1;
+}
+
+// Moves one waiting stdin character into the rx ring
+void pollUart0Stdin()
+{
+    struct pollfd fd = {0, POLLIN, 0};
+    char c;
+    if (!uart0Stdin || uart0RxHead != uart0RxTail)
+        return;
+    if (poll(&fd, 1, 0) == 1 && read(0, &c, 1) == 1)
+    {
+        uart0RxRing[uart0RxHead] = c;
+        uart0RxHead = (uart0RxHead + 1) % UART0_RX_RING_SIZE;
+    }
+}
+
+bool kbhitUart0()
+{
+    pollUart0Stdin();
+    return uart0RxHead != uart0RxTail;
+}
+
+// Returns 0 if no input is waiting (the firmware version would block)
+char getcUart0()
+{
+    char c;
+    if (!kbhitUart0())
+        return 0;
+    c = uart0RxRing[uart0RxTail];
+    uart0RxTail = (uart0RxTail + 1) % UART0_RX_RING_SIZE;
+    return c;
+}
+
+// Queues console input as if it had been typed
+void simTypeUart0(const char str[])
+{
+    while (*str != 0 && (uart0RxHead + 1) % UART0_RX_RING_SIZE != uart0RxTail)
+    {
+        uart0RxRing[uart0RxHead] = *str++;
+        uart0RxHead = (uart0RxHead + 1) % UART0_RX_RING_SIZE;
+    }
+}
+
+void simEnableStdin(bool enable)
+{
+    uart0Stdin = enable;
+}
+
+void simEnableConsole(bool enable)
+{
+    uart0Output = enable;
+}
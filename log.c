@@ -0,0 +1,133 @@
+// Deferred Binary Logging Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// A log site only stores its id, a timestamp and its raw arguments in a ram
+// ring (a few dozen cycles). logDrain() is called from the main loop and
+// moves whole records into the uart0 tx ring when there is room, so logging
+// never waits on the serial link. Formatting happens on the host with
+// tools/logdecode.py.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart0.h"
+#include "log.h"
+#include "perf.h"
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _logRecord
+{
+  uint16_t id;
+  uint8_t argCount;
+  uint32_t time;
+  uint32_t args[LOG_MAX_ARGS];
+} logRecord;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+logRecord logRing[LOG_RING_SIZE];
+uint8_t logHead = 0;
+uint8_t logTail = 0;
+uint32_t logDropped = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Starts the cycle counter used for timestamps
+void initLog()
+{
+    CORE_DEMCR_R |= CORE_DEMCR_TRCENA;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+}
+
+// Queues a record, dropping it if the ring is full
+// Use the LOGn macros rather than calling this directly
+void logWrite(logId id, uint8_t argCount, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    logRecord* record;
+    uint8_t next = (logHead + 1) & (LOG_RING_SIZE - 1);
+    if (next == logTail)
+    {
+        logDropped++;
+        return;
+    }
+    record = &logRing[logHead];
+    record->id = id;
+    record->argCount = argCount;
+    record->time = DWT_CYCCNT_R;
+    record->args[0] = arg0;
+    record->args[1] = arg1;
+    record->args[2] = arg2;
+    record->args[3] = arg3;
+    logHead = next;
+}
+
+// True while records (or a drop report) are waiting
+bool logIsPending()
+{
+    return logTail != logHead || logDropped != 0;
+}
+
+// Serializes a record, returns its size
+uint8_t logEncode(uint8_t buffer[], const logRecord* record)
+{
+    uint8_t size = 0;
+    uint8_t i, j;
+    buffer[size++] = LOG_SYNC;
+    buffer[size++] = record->id & 0xFF;
+    buffer[size++] = record->id >> 8;
+    buffer[size++] = record->argCount;
+    for (j = 0; j < 4; j++)
+        buffer[size++] = record->time >> (j * 8);
+    for (i = 0; i < record->argCount; i++)
+        for (j = 0; j < 4; j++)
+            buffer[size++] = record->args[i] >> (j * 8);
+    return size;
+}
+
+// Moves queued records to the uart without waiting
+// Records that do not fit in the tx ring stay queued for the next call
+void logDrain()
+{
+    uint8_t buffer[8 + 4 * LOG_MAX_ARGS];
+    logRecord dropped;
+    uint8_t size;
+    while (logTail != logHead)
+    {
+        size = logEncode(buffer, &logRing[logTail]);
+        if (size > getUart0TxFree())
+            return;
+        writeUart0((char*)buffer, size, UART0_DROP);
+        logTail = (logTail + 1) & (LOG_RING_SIZE - 1);
+    }
+    // report losses once the backlog is clear
+    if (logDropped != 0)
+    {
+        dropped.id = LOG_DROPPED;
+        dropped.argCount = 1;
+        dropped.time = DWT_CYCCNT_R;
+        dropped.args[0] = logDropped;
+        size = logEncode(buffer, &dropped);
+        if (size <= getUart0TxFree())
+        {
+            writeUart0((char*)buffer, size, UART0_DROP);
+            logDropped = 0;
+        }
+    }
+}
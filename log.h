@@ -0,0 +1,86 @@
+// Deferred Binary Logging Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Set to 0 to compile out every log site
+#ifndef LOG_ENABLED
+#define LOG_ENABLED 1
+#endif
+
+// Records waiting to be drained (power of 2)
+#define LOG_RING_SIZE 32
+#define LOG_MAX_ARGS  4
+
+// Wire format (little endian), interleaved with console text:
+//   0xA5, id (2), argument count (1), cycle count timestamp (4), arguments (4 each)
+// Text on the console is 7-bit, so 0xA5 always starts a record
+#define LOG_SYNC 0xA5
+
+// Message table
+// Ids are assigned in order, so append new messages at the end
+// tools/logdecode.py reads the formats from this list
+#define LOG_MESSAGES \
+    LOG_MSG(LOG_BOOT,            "boot, config %u, warm start %u") \
+    LOG_MSG(LOG_STATE,           "mqtt state %u -> %u") \
+    LOG_MSG(LOG_RX_FRAME,        "rx frame type 0x%04x size %u") \
+    LOG_MSG(LOG_RX_OVERFLOW,     "rx overflow") \
+    LOG_MSG(LOG_ARP_REQUEST,     "arp request for %ip") \
+    LOG_MSG(LOG_ARP_RESOLVED,    "arp resolved %ip") \
+    LOG_MSG(LOG_SUBSCRIBED,      "subscription successful") \
+    LOG_MSG(LOG_UNSUBSCRIBED,    "unsubscribed successfully") \
+    LOG_MSG(LOG_PUBLISHED,       "publish success") \
+    LOG_MSG(LOG_PING,            "ping request, keepalive %u s") \
+    LOG_MSG(LOG_DROPPED,         "%u log records dropped") \
+    LOG_MSG(LOG_MQTT_TIMEOUT,    "mqtt no reply in state %u, request dropped")
+
+#define LOG_MSG(id, format) id,
+typedef enum _logId
+{
+    LOG_MESSAGES
+    LOG_COUNT
+} logId;
+#undef LOG_MSG
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initLog();
+void logWrite(logId id, uint8_t argCount, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+void logDrain();
+bool logIsPending();
+
+// Packs an ip address into one argument for %ip
+#define LOG_IP(ip) (((uint32_t)(ip)[0] << 24) | ((uint32_t)(ip)[1] << 16) | ((uint32_t)(ip)[2] << 8) | (ip)[3])
+
+#if LOG_ENABLED
+#define LOG0(id)                 logWrite(id, 0, 0, 0, 0, 0)
+#define LOG1(id, a)              logWrite(id, 1, (uint32_t)(a), 0, 0, 0)
+#define LOG2(id, a, b)           logWrite(id, 2, (uint32_t)(a), (uint32_t)(b), 0, 0)
+#define LOG3(id, a, b, c)        logWrite(id, 3, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), 0)
+#define LOG4(id, a, b, c, d)     logWrite(id, 4, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d))
+#else
+#define LOG0(id)                 ((void)0)
+#define LOG1(id, a)              ((void)0)
+#define LOG2(id, a, b)           ((void)0)
+#define LOG3(id, a, b, c)        ((void)0)
+#define LOG4(id, a, b, c, d)     ((void)0)
+#endif
+
+#endif
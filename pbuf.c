@@ -0,0 +1,160 @@
+// Packet Buffer Pool Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Two fixed pools of frame buffers, each a free list, so alloc and free are
+// O(1) and there is no heap. A request takes the smallest buffer that fits
+// and moves up to the large pool if the small one is empty. Buffers are
+// handed from the receive path to the protocol code and on to the transmit
+// queue by pointer; the frame itself is never copied.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "uart0.h"
+#include "format.h"
+#include "pbuf.h"
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _pbufPool
+{
+  pbuf* free;
+  uint16_t capacity;
+  uint8_t count;
+  uint8_t inUse;
+  uint8_t maxInUse;         // high-water mark
+  uint32_t allocs;
+  uint32_t failures;        // requests that fit this pool but found it empty
+} pbufPool;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+// Word arrays keep the frames aligned for the header structures
+uint32_t pbufSmallData[PBUF_SMALL_COUNT][(PBUF_SMALL_SIZE + 3) / 4];
+uint32_t pbufLargeData[PBUF_LARGE_COUNT][(PBUF_LARGE_SIZE + 3) / 4];
+pbuf pbufs[PBUF_SMALL_COUNT + PBUF_LARGE_COUNT];
+pbufPool pbufPools[PBUF_POOLS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void pbufAdd(uint8_t pool, pbuf* buffer, uint32_t data[])
+{
+    buffer->data = (uint8_t*)data;
+    buffer->capacity = pbufPools[pool].capacity;
+    buffer->pool = pool;
+    buffer->size = 0;
+    buffer->next = pbufPools[pool].free;
+    pbufPools[pool].free = buffer;
+    pbufPools[pool].count++;
+}
+
+void initPbuf()
+{
+    uint8_t i;
+    for (i = 0; i < PBUF_POOLS; i++)
+    {
+        pbufPools[i].free = NULL;
+        pbufPools[i].count = 0;
+        pbufPools[i].inUse = 0;
+    }
+    pbufPools[0].capacity = PBUF_SMALL_SIZE;
+    pbufPools[1].capacity = PBUF_LARGE_SIZE;
+    for (i = 0; i < PBUF_SMALL_COUNT; i++)
+        pbufAdd(0, &pbufs[i], pbufSmallData[i]);
+    for (i = 0; i < PBUF_LARGE_COUNT; i++)
+        pbufAdd(1, &pbufs[PBUF_SMALL_COUNT + i], pbufLargeData[i]);
+    pbufReset();
+}
+
+// Returns a buffer of at least size bytes, or NULL if none is free
+// The caller owns it and sets size once the frame is in place
+pbuf* pbufAlloc(uint16_t size)
+{
+    pbufPool* pool;
+    pbuf* buffer;
+    bool counted = false;
+    uint8_t i;
+    for (i = 0; i < PBUF_POOLS; i++)
+    {
+        pool = &pbufPools[i];
+        if (pool->capacity < size)
+            continue;
+        if (pool->free == NULL)
+        {
+            // charge the miss to the pool the request was sized for
+            if (!counted)
+                pool->failures++;
+            counted = true;
+            continue;
+        }
+        buffer = pool->free;
+        pool->free = buffer->next;
+        buffer->next = NULL;
+        buffer->size = 0;
+        pool->allocs++;
+        if (++pool->inUse > pool->maxInUse)
+            pool->maxInUse = pool->inUse;
+        return buffer;
+    }
+    return NULL;
+}
+
+void pbufFree(pbuf* buffer)
+{
+    pbufPool* pool;
+    if (buffer == NULL)
+        return;
+    pool = &pbufPools[buffer->pool];
+    buffer->next = pool->free;
+    pool->free = buffer;
+    pool->inUse--;
+}
+
+// Clears the counters, high-water marks restart from what is in use now
+void pbufReset()
+{
+    uint8_t i;
+    for (i = 0; i < PBUF_POOLS; i++)
+    {
+        pbufPools[i].maxInUse = pbufPools[i].inUse;
+        pbufPools[i].allocs = 0;
+        pbufPools[i].failures = 0;
+    }
+}
+
+void pbufDump()
+{
+    char str[FORMAT_DECIMAL_SIZE + 1];
+    pbufPool* pool;
+    uint8_t i;
+    putsUart0("pool   size  count  inuse    max     allocs   failures\n\r");
+    for (i = 0; i < PBUF_POOLS; i++)
+    {
+        pool = &pbufPools[i];
+        putsUart0(i == 0 ? "small" : "large");
+        writeUart0(str, formatDecimalWidth(str, pool->capacity, 6), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, pool->count, 7), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, pool->inUse, 7), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, pool->maxInUse, 7), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, pool->allocs, 11), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, pool->failures, 11), UART0_BLOCK);
+        putsUart0("\n\r");
+    }
+}
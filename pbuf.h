@@ -0,0 +1,51 @@
+// Packet Buffer Pool Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PBUF_H_
+#define PBUF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Small buffers hold arp, acks, pings and short mqtt packets, large ones a
+// full frame: ether header (14) + MTU (1500) + CRC (4) + vlan tag (4)
+#define PBUF_SMALL_SIZE  128
+#define PBUF_SMALL_COUNT 8
+#define PBUF_LARGE_SIZE  1522
+#define PBUF_LARGE_COUNT 3
+
+#define PBUF_POOLS       2
+
+// A frame and who it belongs to
+// Whoever holds the pointer owns the buffer and must free it or pass it on
+typedef struct _pbuf
+{
+  struct _pbuf* next;       // free list or queue link
+  uint8_t* data;
+  uint16_t size;            // bytes of frame in data
+  uint16_t capacity;
+  uint8_t pool;
+} pbuf;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initPbuf();
+pbuf* pbufAlloc(uint16_t size);
+void pbufFree(pbuf* buffer);
+void pbufReset();
+void pbufDump();
+
+#endif
@@ -0,0 +1,120 @@
+// Cycle Count Instrumentation Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Probes read the DWT cycle counter at the start and end of a section and
+// accumulate count/min/max/total per probe. The cost of an empty probe is
+// measured at init and subtracted from every sample. The counter wraps
+// every 107 s, so a single section must be shorter than that.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "uart0.h"
+#include "format.h"
+#include "perf.h"
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _perfStats
+{
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+} perfStats;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+#if PERF_ENABLED
+#define PERF_PROBE(id, name) name,
+const char* const perfNames[PERF_PROBE_COUNT] = {PERF_PROBES};
+#undef PERF_PROBE
+
+perfStats perfTable[PERF_PROBE_COUNT];
+uint32_t perfOverhead = 0;
+#endif
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Starts the cycle counter and measures the cost of an empty probe
+void initPerf()
+{
+    CORE_DEMCR_R |= CORE_DEMCR_TRCENA;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+#if PERF_ENABLED
+    {
+        PERF_BEGIN(calibrate);
+        perfOverhead = DWT_CYCCNT_R - calibrate_start;
+    }
+    perfReset();
+#endif
+}
+
+void perfRecord(uint8_t probe, uint32_t cycles)
+{
+#if PERF_ENABLED
+    perfStats* stats = &perfTable[probe];
+    cycles = (cycles > perfOverhead) ? cycles - perfOverhead : 0;
+    if (stats->count == 0 || cycles < stats->min)
+        stats->min = cycles;
+    if (cycles > stats->max)
+        stats->max = cycles;
+    stats->total += cycles;
+    stats->count++;
+#endif
+}
+
+void perfReset()
+{
+#if PERF_ENABLED
+    uint8_t i;
+    for (i = 0; i < PERF_PROBE_COUNT; i++)
+    {
+        perfTable[i].count = 0;
+        perfTable[i].min = 0;
+        perfTable[i].max = 0;
+        perfTable[i].total = 0;
+    }
+#endif
+}
+
+// Prints the table in cycles, skipping probes that never ran
+void perfDump()
+{
+#if PERF_ENABLED
+    char str[FORMAT_DECIMAL_SIZE + 1];
+    uint8_t i;
+    putsUart0("probe                     count        min        max       mean\n\r");
+    for (i = 0; i < PERF_PROBE_COUNT; i++)
+    {
+        if (perfTable[i].count == 0)
+            continue;
+        putsUart0((char*)perfNames[i]);
+        writeUart0("                    ", 20 - strlen(perfNames[i]), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, perfTable[i].count, 11), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, perfTable[i].min, 11), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, perfTable[i].max, 11), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, perfTable[i].total / perfTable[i].count, 11), UART0_BLOCK);
+        putsUart0("\n\r");
+    }
+#else
+    putsUart0("Build with PERF_ENABLED 1\n\r");
+#endif
+}
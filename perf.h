@@ -0,0 +1,96 @@
+// Cycle Count Instrumentation Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Set to 1 to build the probes in; at 0 they and the table compile out
+#ifndef PERF_ENABLED
+#define PERF_ENABLED 0
+#endif
+
+// DWT cycle counter (not in tm4c123gh6pm.h)
+#define CORE_DEMCR_R       (*((volatile uint32_t *)0xE000EDFC))
+#define CORE_DEMCR_TRCENA  0x01000000
+#define DWT_CTRL_R         (*((volatile uint32_t *)0xE0001000))
+#define DWT_CTRL_CYCCNTENA 0x00000001
+#define DWT_CYCCNT_R       (*((volatile uint32_t *)0xE0001004))
+
+// Probe table, one entry per instrumented section
+// The PERF_SCHED_ entries must stay in SCHED_EVENTS order and the
+// PERF_MQTT_ entries in TCPState order
+#define PERF_PROBES \
+    PERF_PROBE(PERF_ETHER_GET_FRAME,   "etherGetFrame") \
+    PERF_PROBE(PERF_ETHER_PUT_PACKET,  "etherPutPacket") \
+    PERF_PROBE(PERF_ETHER_SEND_TCP,    "etherSendTcp") \
+    PERF_PROBE(PERF_ETHER_SUM_WORDS,   "etherSumWords") \
+    PERF_PROBE(PERF_ETHER_REG_OP,      "ether register op") \
+    PERF_PROBE(PERF_DISPATCH,          "classify+dispatch") \
+    PERF_PROBE(PERF_SCHED_RX_FRAME,    "event rx frame") \
+    PERF_PROBE(PERF_SCHED_TX_DONE,     "event tx done") \
+    PERF_PROBE(PERF_SCHED_TIMER,       "event timer") \
+    PERF_PROBE(PERF_SCHED_UART_LINE,   "event uart line") \
+    PERF_PROBE(PERF_SCHED_BUTTON,      "event button") \
+    PERF_PROBE(PERF_SCHED_MQTT,        "event mqtt") \
+    PERF_PROBE(PERF_SCHED_LOG,         "event log drain") \
+    PERF_PROBE(PERF_SCHED_STATS,       "event stats publish") \
+    PERF_PROBE(PERF_MQTT_SYN_SENT,     "mqtt SynSent") \
+    PERF_PROBE(PERF_MQTT_SYN_ACK_RCVD, "mqtt SynAckRcvd") \
+    PERF_PROBE(PERF_MQTT_ESTABLISHED,  "mqtt Established") \
+    PERF_PROBE(PERF_MQTT_SEND_ACK,     "mqtt sendAckState") \
+    PERF_PROBE(PERF_MQTT_PUBLISH,      "mqtt publishMQTT") \
+    PERF_PROBE(PERF_MQTT_SUBSCRIBE,    "mqtt subscribeMQTT") \
+    PERF_PROBE(PERF_MQTT_DISCONNECT,   "mqtt disconnectReq") \
+    PERF_PROBE(PERF_MQTT_SUB_ACK,      "mqtt subAck") \
+    PERF_PROBE(PERF_MQTT_UNSUB_REQ,    "mqtt sendUnsubReq") \
+    PERF_PROBE(PERF_MQTT_UNSUB_ACK,    "mqtt unSubAck") \
+    PERF_PROBE(PERF_MQTT_FIN_WAIT1,    "mqtt FinWait1") \
+    PERF_PROBE(PERF_MQTT_FIN_WAIT2,    "mqtt FinWait2") \
+    PERF_PROBE(PERF_MQTT_TIME_WAIT,    "mqtt TimeWait") \
+    PERF_PROBE(PERF_MQTT_CLOSED,       "mqtt closed")
+
+#define PERF_PROBE(id, name) id,
+typedef enum _perfProbe
+{
+    PERF_PROBES
+    PERF_PROBE_COUNT
+} perfProbe;
+#undef PERF_PROBE
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initPerf();
+void perfRecord(uint8_t probe, uint32_t cycles);
+void perfReset();
+void perfDump();
+
+// PERF_BEGIN(x) and PERF_END(x) must be in the same block
+// PERF_END_AS(x, probe) charges the section to a probe chosen at run time
+// (probe is still evaluated when disabled, so its inputs count as used)
+#if PERF_ENABLED
+#define PERF_BEGIN(id)           uint32_t id##_start = DWT_CYCCNT_R
+#define PERF_END(id)             perfRecord(id, DWT_CYCCNT_R - id##_start)
+#define PERF_END_AS(id, probe)   perfRecord(probe, DWT_CYCCNT_R - id##_start)
+#else
+#define PERF_BEGIN(id)           ((void)0)
+#define PERF_END(id)             ((void)0)
+#define PERF_END_AS(id, probe)   ((void)(probe))
+#endif
+
+#endif
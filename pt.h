@@ -0,0 +1,85 @@
+// Protothread Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Stackless coroutines in the style of Dunkels' protothreads. A thread is a
+// function that is called again and again; PT_BEGIN jumps back to the line
+// where it last blocked, so a sequence of waits reads top to bottom. The
+// only state kept between calls is the 4 byte pt, so many threads can run at
+// once. Locals do not survive a wait (use static or global storage), a
+// switch statement cannot span a wait, and there can be one wait per line.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef PT_H_
+#define PT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "timer.h"
+
+// Thread return values
+#define PT_WAITING 0
+#define PT_YIELDED 1
+#define PT_EXITED  2
+#define PT_ENDED   3
+
+typedef struct _pt
+{
+  uint16_t lc;              // line to resume at, 0 to start over
+  bool timedOut;            // how the last PT_WAIT_UNTIL_TIMEOUT ended
+} pt;
+
+#define PT_THREAD(declaration) uint8_t declaration
+
+#define PT_INIT(p)  ((p)->lc = 0)
+
+#define PT_BEGIN(p) { bool ptYielded = true; (void)ptYielded; switch ((p)->lc) { case 0:
+
+#define PT_END(p)   } PT_INIT(p); return PT_ENDED; }
+
+// Blocks until c is true, c is evaluated each time the thread is called
+#define PT_WAIT_UNTIL(p, c) \
+    do { (p)->lc = __LINE__; case __LINE__: if (!(c)) return PT_WAITING; } while (0)
+
+#define PT_WAIT_WHILE(p, c) PT_WAIT_UNTIL(p, !(c))
+
+// Gives way once to whatever else is ready
+#define PT_YIELD(p) \
+    do { ptYielded = false; (p)->lc = __LINE__; case __LINE__: if (!ptYielded) return PT_YIELDED; } while (0)
+
+// Runs a child thread until it ends
+#define PT_WAIT_THREAD(p, thread) PT_WAIT_WHILE(p, (thread) < PT_EXITED)
+#define PT_SPAWN(p, child, thread) \
+    do { PT_INIT(child); PT_WAIT_THREAD(p, thread); } while (0)
+
+#define PT_RESTART(p) do { PT_INIT(p); return PT_WAITING; } while (0)
+#define PT_EXIT(p)    do { PT_INIT(p); return PT_EXITED; } while (0)
+
+// True while the thread has not finished
+#define PT_SCHEDULE(f) ((f) < PT_EXITED)
+
+// Blocks until c is true or ticks have passed on the wheel timer t
+// Afterwards PT_TIMED_OUT(p) says which; c is checked first, so a wait that
+// is satisfied in the same poll the timer expires counts as success
+// On success t is left running, which is harmless as it has no callback
+#define PT_WAIT_UNTIL_TIMEOUT(p, t, ticks, c) \
+    do { \
+        timerStart(t, ticks, 0, NULL, NULL); \
+        (p)->timedOut = false; \
+        PT_WAIT_UNTIL(p, (c) || ((p)->timedOut = !timerIsActive(t))); \
+    } while (0)
+#define PT_TIMED_OUT(p) ((p)->timedOut)
+
+#define PT_SLEEP(p, t, ticks) PT_WAIT_UNTIL_TIMEOUT(p, t, ticks, false)
+
+#endif
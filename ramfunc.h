@@ -0,0 +1,34 @@
+// SRAM Code Placement
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Above 40 MHz the flash needs a wait state and only the prefetch buffer
+// hides it, so every taken branch in a short loop stalls. Functions marked
+// RAMFUNC are linked into .ramfunc, which is stored in flash and copied to
+// SRAM by ResetISR, and run from there without wait states.
+// Placement is opt-in: define USE_RAMFUNC in the project to enable it,
+// otherwise RAMFUNC is empty and everything stays in flash.
+// SRAM code is fetched over the system bus, so it competes with the loads
+// and stores of the data it works on; only mark functions whose time is
+// spent in branches, not in waiting on a peripheral or on memory.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef RAMFUNC_H_
+#define RAMFUNC_H_
+
+#ifdef USE_RAMFUNC
+#define RAMFUNC __attribute__((section(".ramfunc")))
+#else
+#define RAMFUNC
+#endif
+
+#endif
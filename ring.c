@@ -0,0 +1,104 @@
+// Single Producer Single Consumer Ring Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hands elements from an interrupt to the main loop (or back) without
+// masking interrupts. The producer copies the element and then advances
+// head; the consumer copies it out and then advances tail. Each index has
+// one writer and aligned 16-bit stores are atomic on the M4, so the only
+// ordering needed is the barrier between the copy and the index update.
+// LDREX/STREX would only be needed with more than one producer or consumer
+// per ring; use one ring per isr instead. One slot is kept empty to tell a
+// full ring from an empty one.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ring.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// count must be a power of 2, the ring holds count - 1 elements
+void ringInit(ring* r, void* buffer, uint16_t count, uint8_t elementSize)
+{
+    r->buffer = (uint8_t*)buffer;
+    r->mask = count - 1;
+    r->elementSize = elementSize;
+    r->head = 0;
+    r->tail = 0;
+    r->maxDepth = 0;
+    r->dropped = 0;
+}
+
+// Producer side, never waits
+// Returns false (and counts a drop) if the ring is full
+bool ringPut(ring* r, const void* element)
+{
+    uint16_t head = r->head;
+    uint16_t next = (head + 1) & r->mask;
+    uint16_t depth;
+    const uint8_t* src = (const uint8_t*)element;
+    uint8_t* dst;
+    uint8_t i;
+    if (next == r->tail)
+    {
+        r->dropped++;
+        return false;
+    }
+    dst = &r->buffer[head * r->elementSize];
+    for (i = 0; i < r->elementSize; i++)
+        dst[i] = src[i];
+    RING_BARRIER();
+    r->head = next;
+    depth = (next - r->tail) & r->mask;
+    if (depth > r->maxDepth)
+        r->maxDepth = depth;
+    return true;
+}
+
+// Consumer side, never waits
+// Returns false if the ring is empty
+bool ringGet(ring* r, void* element)
+{
+    uint16_t tail = r->tail;
+    const uint8_t* src;
+    uint8_t* dst = (uint8_t*)element;
+    uint8_t i;
+    if (tail == r->head)
+        return false;
+    RING_BARRIER();
+    src = &r->buffer[tail * r->elementSize];
+    for (i = 0; i < r->elementSize; i++)
+        dst[i] = src[i];
+    RING_BARRIER();
+    r->tail = (tail + 1) & r->mask;
+    return true;
+}
+
+bool ringIsEmpty(const ring* r)
+{
+    return r->head == r->tail;
+}
+
+// Elements waiting, at least this many as seen by the consumer
+uint16_t ringCount(const ring* r)
+{
+    return (r->head - r->tail) & r->mask;
+}
+
+// Free slots, at least this many as seen by the producer
+uint16_t ringFree(const ring* r)
+{
+    return (r->tail - r->head - 1) & r->mask;
+}
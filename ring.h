@@ -0,0 +1,52 @@
+// Single Producer Single Consumer Ring Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Orders the element copy against the index update that publishes it
+// (the host build maps this to a compiler and cpu fence)
+#ifndef RING_BARRIER
+#define RING_BARRIER() __asm(" dmb")
+#endif
+
+// One side (an isr or the main loop) puts, the other gets
+// head is written only by the producer and tail only by the consumer, so
+// neither side needs a lock or has to mask interrupts
+typedef struct _ring
+{
+  uint8_t* buffer;
+  uint16_t mask;            // element count - 1, count is a power of 2
+  uint8_t elementSize;
+  volatile uint16_t head;   // next slot to fill
+  volatile uint16_t tail;   // next slot to empty
+  uint16_t maxDepth;        // high-water mark (producer side)
+  volatile uint32_t dropped;
+} ring;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void ringInit(ring* r, void* buffer, uint16_t count, uint8_t elementSize);
+bool ringPut(ring* r, const void* element);
+bool ringGet(ring* r, void* element);
+bool ringIsEmpty(const ring* r);
+uint16_t ringCount(const ring* r);
+uint16_t ringFree(const ring* r);
+
+#endif
@@ -0,0 +1,185 @@
+// Cooperative Event Scheduler Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Each subsystem registers a handler for its events and, for hardware that
+// is polled, a source that posts them. schedRun() polls the sources and
+// then runs the oldest event of the highest priority queue that is not
+// empty. Handlers run to completion, so a received frame waits at most for
+// the one handler already running, never behind a queue of bulk work.
+// Handler run time is charged to the PERF_SCHED_ probes (perf command).
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "uart0.h"
+#include "format.h"
+#include "perf.h"
+#include "sched.h"
+
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _schedEntry
+{
+  uint8_t event;
+  uint32_t arg;
+} schedEntry;
+
+typedef struct _schedQueue
+{
+  schedEntry entries[SCHED_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t tail;
+  uint8_t maxDepth;
+} schedQueue;
+
+typedef struct _schedStats
+{
+  uint32_t posted;
+  uint32_t dropped;
+} schedStats;
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+#define SCHED_EVENT(id, priority, name) priority,
+const uint8_t schedPriorities[SCHED_EVENT_COUNT] = {SCHED_EVENTS};
+#undef SCHED_EVENT
+
+#define SCHED_EVENT(id, priority, name) name,
+const char* const schedNames[SCHED_EVENT_COUNT] = {SCHED_EVENTS};
+#undef SCHED_EVENT
+
+schedHandler schedHandlers[SCHED_EVENT_COUNT];
+uint8_t schedQueued[SCHED_EVENT_COUNT];
+schedStats schedTable[SCHED_EVENT_COUNT];
+schedQueue schedQueues[SCHED_PRIORITIES];
+schedSource schedSources[SCHED_MAX_SOURCES];
+uint8_t schedSourceCount = 0;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initSched()
+{
+    memset(schedHandlers, 0, sizeof(schedHandlers));
+    memset(schedQueued, 0, sizeof(schedQueued));
+    memset(schedQueues, 0, sizeof(schedQueues));
+    schedSourceCount = 0;
+    schedReset();
+}
+
+void schedRegister(schedEvent event, schedHandler handler)
+{
+    schedHandlers[event] = handler;
+}
+
+void schedAddSource(schedSource source)
+{
+    if (schedSourceCount < SCHED_MAX_SOURCES)
+        schedSources[schedSourceCount++] = source;
+}
+
+// Queues an event at its priority
+// Returns false (and counts a drop) if that queue is full
+bool schedPost(schedEvent event, uint32_t arg)
+{
+    schedQueue* queue = &schedQueues[schedPriorities[event]];
+    uint8_t next = (queue->head + 1) & (SCHED_QUEUE_SIZE - 1);
+    uint8_t depth;
+    if (next == queue->tail)
+    {
+        schedTable[event].dropped++;
+        return false;
+    }
+    queue->entries[queue->head].event = event;
+    queue->entries[queue->head].arg = arg;
+    queue->head = next;
+    depth = (queue->head - queue->tail) & (SCHED_QUEUE_SIZE - 1);
+    if (depth > queue->maxDepth)
+        queue->maxDepth = depth;
+    schedQueued[event]++;
+    schedTable[event].posted++;
+    return true;
+}
+
+// Lets a source post level-triggered events once
+bool schedIsQueued(schedEvent event)
+{
+    return schedQueued[event] != 0;
+}
+
+// Polls the sources and runs at most one event
+// Returns true if an event ran
+bool schedRun()
+{
+    schedQueue* queue;
+    schedEntry entry;
+    uint8_t i;
+
+    for (i = 0; i < schedSourceCount; i++)
+        schedSources[i]();
+
+    for (i = 0; i < SCHED_PRIORITIES; i++)
+    {
+        queue = &schedQueues[i];
+        if (queue->head != queue->tail)
+        {
+            entry = queue->entries[queue->tail];
+            queue->tail = (queue->tail + 1) & (SCHED_QUEUE_SIZE - 1);
+            schedQueued[entry.event]--;
+            if (schedHandlers[entry.event] != NULL)
+            {
+                PERF_BEGIN(handler);
+                schedHandlers[entry.event](entry.arg);
+                PERF_END_AS(handler, PERF_SCHED_RX_FRAME + entry.event);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void schedReset()
+{
+    uint8_t i;
+    memset(schedTable, 0, sizeof(schedTable));
+    for (i = 0; i < SCHED_PRIORITIES; i++)
+        schedQueues[i].maxDepth = 0;
+}
+
+// Prints events posted and dropped and the deepest each queue has been
+void schedDump()
+{
+    char str[FORMAT_DECIMAL_SIZE + 1];
+    uint8_t i;
+    putsUart0("event               pri     posted    dropped\n\r");
+    for (i = 0; i < SCHED_EVENT_COUNT; i++)
+    {
+        putsUart0((char*)schedNames[i]);
+        writeUart0("                    ", 16 - strlen(schedNames[i]), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, schedPriorities[i], 7), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, schedTable[i].posted, 11), UART0_BLOCK);
+        writeUart0(str, formatDecimalWidth(str, schedTable[i].dropped, 11), UART0_BLOCK);
+        putsUart0("\n\r");
+    }
+    putsUart0("max queue depth ");
+    for (i = 0; i < SCHED_PRIORITIES; i++)
+        writeUart0(str, formatDecimalWidth(str, schedQueues[i].maxDepth, 4), UART0_BLOCK);
+    putsUart0("\n\r");
+}
@@ -0,0 +1,71 @@
+// Cooperative Event Scheduler Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Events waiting per priority (power of 2)
+#define SCHED_QUEUE_SIZE  8
+#define SCHED_MAX_SOURCES 8
+
+// Priorities, a lower number always runs first
+#define SCHED_HIGH       0      // received frames (acks, arp and ping replies)
+#define SCHED_NORMAL     1      // timers, console, connection progress
+#define SCHED_LOW        2      // bulk work (log draining, statistics publishes)
+#define SCHED_PRIORITIES 3
+
+// Event table: id, priority, name
+// The PERF_SCHED_ probes must stay in this order
+#define SCHED_EVENTS \
+    SCHED_EVENT(EVENT_RX_FRAME,  SCHED_HIGH,   "rx frame") \
+    SCHED_EVENT(EVENT_TX_DONE,   SCHED_HIGH,   "tx done") \
+    SCHED_EVENT(EVENT_TIMER,     SCHED_NORMAL, "timer") \
+    SCHED_EVENT(EVENT_UART_LINE, SCHED_NORMAL, "uart line") \
+    SCHED_EVENT(EVENT_BUTTON,    SCHED_NORMAL, "button") \
+    SCHED_EVENT(EVENT_MQTT,      SCHED_NORMAL, "mqtt") \
+    SCHED_EVENT(EVENT_LOG,       SCHED_LOW,    "log drain") \
+    SCHED_EVENT(EVENT_STATS,     SCHED_LOW,    "stats publish")
+
+#define SCHED_EVENT(id, priority, name) id,
+typedef enum _schedEvent
+{
+    SCHED_EVENTS
+    SCHED_EVENT_COUNT
+} schedEvent;
+#undef SCHED_EVENT
+
+// Runs to completion, arg is the value given to schedPost()
+typedef void (*schedHandler)(uint32_t arg);
+
+// Polled before each dispatch to post events for hardware that has no
+// interrupt (the ENC28J60 flags, uart characters)
+typedef void (*schedSource)();
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initSched();
+void schedRegister(schedEvent event, schedHandler handler);
+void schedAddSource(schedSource source);
+bool schedPost(schedEvent event, uint32_t arg);
+bool schedIsQueued(schedEvent event);
+bool schedRun();
+void schedReset();
+void schedDump();
+
+#endif
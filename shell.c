@@ -2,202 +2,368 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
-#include <stdlib.h>
 #include "tm4c123gh6pm.h"
-#include "wait.h"
-#include "gpio.h"
-#include "spi0.h"
 #include "shell.h"
 #include "uart0.h"
+#include "config.h"
+#include "format.h"
+#include "perf.h"
+#include "sched.h"
+#include "pbuf.h"
 
 
+// ------------------------------------------------------------------------------
+//  Structures
+// ------------------------------------------------------------------------------
+
+typedef struct _shellCommand
+{
+  const char* name;
+  uint8_t minArgs;
+  uint8_t maxArgs;
+  void (*handler)(const shellArg args[], uint8_t argCount);
+  const char* usage;
+} shellCommand;
+
 // ------------------------------------------------------------------------------
 //  Globals
 // ------------------------------------------------------------------------------
 
 uint8_t count=0;
 char str[MAX_CHARS+1];
-char str1[30];
-char str2[30];
-char str3[30];
-uint8_t pos[MAX_FIELDS];
-uint8_t argCount=0;
 extern uint8_t publishFlag;
 extern uint8_t subscribeFlag;
 extern TCPState NextState;
-uint8_t clientId[4];
 extern uint8_t connectFlag;
+extern char mqttTopic[MQTT_TOPIC_SIZE];
+extern char mqttMessage[MQTT_MESSAGE_SIZE];
+extern uint16_t statsInterval;
+void displayConnectionInfo();
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
 
-void posArg()
+// Adds one received character to the line being edited
+// Returns true when str holds a complete line (count is its length)
+bool getStringChar(char c)
 {
-    uint8_t i; argCount = 0;
+    if(c == 8 || c == 127)
+    {
+        if(count>0){count--;}
+        return false;
+    }
+
+    if(c == 10 || c == 13)
+    {
+        str[count] = 0x00;
+        return true;
+    }
 
-    //empty out the argument position string
-    for (i=0;i<5;i++){pos[i]=0;}
+    if(c>=32){str[count++] = c;}
 
-    // Here count is a global variable containing length of string
-    for (i = 0; i < count; i++)
+    if(count == MAX_CHARS)
     {
-        if(str[i]==32 | str[i]==44)
+        str[count] = 0x00;
+        putsUart0("You have exceeded the maximum characters, you typed\r\n");
+        return true;
+    }
+    return false;
+}
+
+// Splits line in place at spaces and commas
+// Each argument is a null terminated view into line, nothing is copied
+// Returns the number of arguments found (at most maxArgs)
+uint8_t tokenize(char line[], uint8_t size, shellArg args[], uint8_t maxArgs)
+{
+    uint8_t argCount = 0;
+    uint8_t i;
+    bool inArg = false;
+    for (i = 0; i < size; i++)
+    {
+        if (line[i] == ' ' || line[i] == ',')
         {
-            str[i]=0x00;
+            line[i] = 0;
+            inArg = false;
         }
-        if(str[i]!=0x00 & str[i-1]==0x00)
+        else if (!inArg)
         {
-            pos[argCount] = i;
+            if (argCount == maxArgs)
+                break;
+            args[argCount].str = &line[i];
+            args[argCount].size = 0;
             argCount++;
+            inArg = true;
         }
-
+        if (inArg)
+            args[argCount-1].size++;
     }
-    return;
+    return argCount;
 }
 
-void parseString()
+// Parses an unsigned decimal integer
+// Returns false if arg is empty, has other characters or overflows
+bool parseInt(shellArg arg, uint32_t* value)
 {
-    uint8_t i; uint8_t tempCount=0;
-
-    for(i=0;i<20;i++)
+    uint32_t result = 0;
+    uint8_t i;
+    if (arg.size == 0)
+        return false;
+    for (i = 0; i < arg.size; i++)
     {
-        str1[i]=0; str2[i]=0; str3[i]=0;
+        if (arg.str[i] < '0' || arg.str[i] > '9' || result > (0xFFFFFFFF - 9) / 10)
+            return false;
+        result = result * 10 + (arg.str[i] - '0');
     }
+    *value = result;
+    return true;
+}
 
-    for (i=pos[0];i<20;i++)
+// Parses a dotted quad
+// Returns false unless arg is exactly four octets of 0-255
+bool parseIp(shellArg arg, uint8_t ip[4])
+{
+    shellArg octet;
+    uint32_t value;
+    uint8_t i = 0;
+    uint8_t j;
+    for (j = 0; j < 4; j++)
     {
-        if(str[i]==0){break;}
-        else str1[tempCount++] = str[i];
+        octet.str = &arg.str[i];
+        octet.size = 0;
+        while (i < arg.size && arg.str[i] != '.')
+        {
+            octet.size++;
+            i++;
+        }
+        if (!parseInt(octet, &value) || value > 255)
+            return false;
+        ip[j] = value;
+        // skip the dot, which must separate octets and not end the address
+        if (j < 3 && (i == arg.size || ++i == arg.size))
+            return false;
     }
+    return i == arg.size;
+}
 
-    if(pos[1]!=0)
-    {
-    tempCount = 0;
-    for (i=pos[1];i<count;i++)
+// Copies a string argument to persistent storage of size bytes
+// Returns false if it does not fit
+bool copyArg(shellArg arg, char dest[], uint8_t size)
+{
+    if (arg.size >= size)
     {
-        if(str[i]==0){break;}
-        else str2[tempCount++] = str[i];
-    }
+        putsUart0("Argument too long\n\r");
+        return false;
     }
+    memcpy(dest, arg.str, arg.size);
+    dest[arg.size] = 0;
+    return true;
+}
 
-    if(pos[2]!=0)
-    {
-    tempCount = 0;
-    for (i=pos[2];i<count;i++)
+void connCommand(const shellArg args[], uint8_t argCount)
+{
+    connectFlag = 1;
+    NextState = closed;
+}
+
+void fmtbenchCommand(const shellArg args[], uint8_t argCount)
+{
+    formatBenchmark();
+}
+
+void ifconfigCommand(const shellArg args[], uint8_t argCount)
+{
+    displayConnectionInfo();
+}
+
+void netstatCommand(const shellArg args[], uint8_t argCount)
+{
+    uint32_t seconds;
+    const uint32_t* values = (const uint32_t*)&netStats;
+    char label[12];
+    uint8_t i, size;
+    if (argCount == 1 && strcmp(args[0].str, "reset") == 0)
+        etherResetStats();
+    else if (argCount == 2 && strcmp(args[0].str, "pub") == 0 && parseInt(args[1], &seconds) && seconds <= 0xFFFF)
+        statsInterval = seconds;
+    else if (argCount == 0)
     {
-        if(str[i]==0){break;}
-        else str3[tempCount++] = str[i];
-    }
+        for (i = 0; i < ETHER_STAT_COUNT; i++)
+        {
+            size = strlen(etherStatNames[i]);
+            memcpy(label, etherStatNames[i], size);
+            memset(&label[size], ' ', sizeof(label) - size - 1);
+            label[sizeof(label) - 1] = 0;
+            putCounterUart0(label, values[i]);
+        }
     }
+    else
+        putsUart0("Usage: netstat [reset | pub SECONDS]\n\r");
+}
 
-    return;
+void schedCommand(const shellArg args[], uint8_t argCount)
+{
+    if (argCount == 1 && strcmp(args[0].str, "reset") == 0)
+        schedReset();
+    else
+        schedDump();
 }
 
+void poolCommand(const shellArg args[], uint8_t argCount)
+{
+    if (argCount == 1 && strcmp(args[0].str, "reset") == 0)
+        pbufReset();
+    else
+        pbufDump();
+}
 
-void getString()
+void perfCommand(const shellArg args[], uint8_t argCount)
 {
-    char c; count = 0;
-        Loop1:
-        c = getcUart0();
-          if(c == 8 | c == 127)
-            {
-                if(count>0){count--;goto Loop1;}
-                else{goto Loop1;}
-            }
+    if (argCount == 1 && strcmp(args[0].str, "reset") == 0)
+        perfReset();
+    else
+        perfDump();
+}
 
-          if(c == 10 | c == 13){str[count] = 0x00; return;}
-          else
-            {
-                if(c>=32){str[count++] = c;}
-                else goto Loop1;
-            }
+void pubCommand(const shellArg args[], uint8_t argCount)
+{
+    if (copyArg(args[0], mqttTopic, MQTT_TOPIC_SIZE) && copyArg(args[1], mqttMessage, MQTT_MESSAGE_SIZE))
+    {
+        publishFlag = 1;
+        NextState = closed;
+    }
+}
 
-            if(count == MAX_CHARS)
-            {
-                str[count] = 0x00;
-                putsUart0("You have exceeded the maximum characters, you typed\r\n");
-                return;
-             }
-            else goto Loop1;
+void rebootCommand(const shellArg args[], uint8_t argCount)
+{
+    putsUart0("Rebooting.......................");
+    NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
 }
 
-void getIpFromStr()
+void setipCommand(const shellArg args[], uint8_t argCount)
 {
-    char tempStr[5]; uint8_t i; uint8_t j=0; uint8_t k=0;
-    for(i=0;i<strlen(str2)+1;i++)
+    uint8_t ip[4];
+    if (!parseIp(args[0], ip))
     {
-        if(str2[i]==0)
-        {
-            clientId[j] = atoi(tempStr);
-            break;
-        }
-
-        if(str2[i]!='.')
-            tempStr[k++] = str2[i];
-        else
-        {
-            clientId[j++] = atoi(tempStr);
-            for(k=0;k<5;k++)
-            {tempStr[k]=0;}
-            k = 0;
-        }
+        putsUart0("Invalid ip address\n\r");
+        return;
     }
+    etherSetIpAddress(ip[0], ip[1], ip[2], ip[3]);
+    memcpy(cfg.fields.ip, ip, 4);
+    commitConfig();
 }
 
-void isCommand()
+void subCommand(const shellArg args[], uint8_t argCount)
 {
-    if(strcmp(str1,"pub")==0)
+    if (copyArg(args[0], mqttTopic, MQTT_TOPIC_SIZE))
     {
-            publishFlag=1;
-            NextState = closed;
-            putsUart0("\n\r");
+        subscribeFlag = 1;
+        NextState = closed;
     }
+}
+
+void unsubCommand(const shellArg args[], uint8_t argCount)
+{
+    if (copyArg(args[0], mqttTopic, MQTT_TOPIC_SIZE))
+        NextState = sendUnsubReq;
+}
+
+void helpCommand(const shellArg args[], uint8_t argCount);
+
+// Must stay sorted by name for the binary search in isCommand()
+const shellCommand commands[] =
+{
+    {"conn",     0, 0, connCommand,     "conn"},
+    {"fmtbench", 0, 0, fmtbenchCommand, "fmtbench"},
+    {"help",     0, 0, helpCommand,     "help"},
+    {"ifconfig", 0, 0, ifconfigCommand, "ifconfig"},
+    {"netstat",  0, 2, netstatCommand,  "netstat [reset | pub SECONDS]"},
+    {"perf",     0, 1, perfCommand,     "perf [reset]"},
+    {"pool",     0, 1, poolCommand,     "pool [reset]"},
+    {"pub",      2, 2, pubCommand,      "pub TOPIC MESSAGE"},
+    {"reboot",   0, 0, rebootCommand,   "reboot"},
+    {"sched",    0, 1, schedCommand,    "sched [reset]"},
+    {"setip",    1, 1, setipCommand,    "setip A.B.C.D"},
+    {"sub",      1, 1, subCommand,      "sub TOPIC"},
+    {"unsub",    1, 1, unsubCommand,    "unsub TOPIC"},
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
 
-    else if(strcmp(str1,"sub")==0)
+void helpCommand(const shellArg args[], uint8_t argCount)
+{
+    uint8_t i;
+    for (i = 0; i < COMMAND_COUNT; i++)
     {
-            subscribeFlag=1;
-            NextState = closed;
-            putsUart0("\n\r");
+        putsUart0((char*)commands[i].usage);
+        putsUart0("\n\r");
     }
+}
 
-    else if(strcmp(str1,"ifconfig")==0)
-        {
-            putsUart0("\n\r");
-            displayConnectionInfo();
-        }
-
-    else if(strcmp(str1,"setip")==0)
-        {
-            getIpFromStr();
-            etherSetIpAddress(clientId[0],clientId[1],clientId[2], clientId[3]);
-            writeEeprom(1, clientId[0]);
-            writeEeprom(2, clientId[1]);
-            writeEeprom(3, clientId[2]);
-            writeEeprom(4, clientId[3]);
-            putsUart0("\n\r");
-        }
+// Returns the command named name or NULL
+const shellCommand* findCommand(const char name[])
+{
+    int8_t low = 0;
+    int8_t high = COMMAND_COUNT - 1;
+    int8_t middle;
+    int result;
+    while (low <= high)
+    {
+        middle = (low + high) / 2;
+        result = strcmp(name, commands[middle].name);
+        if (result == 0)
+            return &commands[middle];
+        if (result < 0)
+            high = middle - 1;
+        else
+            low = middle + 1;
+    }
+    return NULL;
+}
 
-    else if(strcmp(str1,"conn")==0)
-       {
-            connectFlag = 1;
-           NextState = closed;
-           putsUart0("\n\r");
-       }
-    else if(strcmp(str1,"unsub")==0)
-        {
-            NextState = sendUnsubReq;
-            putsUart0("\n\r");
-        }
+// Runs the command in line (size characters, null terminated)
+void isCommand(char line[], uint8_t size)
+{
+    shellArg args[MAX_FIELDS];
+    uint8_t argCount = tokenize(line, size, args, MAX_FIELDS);
+    const shellCommand* command;
 
-    else if(strcmp("reboot", str1)==0 )
+    putsUart0("\n\r");
+    if (argCount == 0)
+        return;
+    command = findCommand(args[0].str);
+    if (command == NULL)
+    {
+        putsUart0("Unknown command, try help\n\r");
+        return;
+    }
+    if (argCount - 1 < command->minArgs || argCount - 1 > command->maxArgs)
     {
-        putsUart0("\r\nRebooting.......................");
-        NVIC_APINT_R = NVIC_APINT_VECTKEY| NVIC_APINT_SYSRESETREQ;
+        putsUart0("Usage: ");
+        putsUart0((char*)command->usage);
+        putsUart0("\n\r");
+        return;
     }
+    command->handler(&args[1], argCount - 1);
+}
 
+// Processes the characters received so far without waiting for more
+// Returns true once str holds a complete line, further input is left in
+// the uart until shellExecute() has run it
+bool shellPoll()
+{
+    while (kbhitUart0())
+    {
+        // ignore the empty line left by a CR LF pair
+        if (getStringChar(getcUart0()) && count > 0)
+            return true;
+    }
+    return false;
 }
 
-void shell()
+// Runs the line collected by shellPoll() (EVENT_UART_LINE handler)
+void shellExecute(uint32_t arg)
 {
-    getString();
-    // To process the string, calculate the positions of arguments
-    posArg(); parseString();
-    isCommand();
+    isCommand(str, count);
+    count = 0;
 }
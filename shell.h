@@ -9,16 +9,28 @@
 #define MAX_CHARS 80
 #define MAX_FIELDS 6
 
+// Storage for the mqtt request started from the shell
+#define MQTT_TOPIC_SIZE 30
+#define MQTT_MESSAGE_SIZE (MAX_CHARS+1)
+
+// View into the command line (null terminated in place)
+typedef struct _shellArg
+{
+  const char* str;
+  uint8_t size;
+} shellArg;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void isCommand();
-void parseString();
-void posArg();
-void getString();
-void shell();
-void getIpFromStr();
+bool getStringChar(char c);
+uint8_t tokenize(char line[], uint8_t size, shellArg args[], uint8_t maxArgs);
+bool parseInt(shellArg arg, uint32_t* value);
+bool parseIp(shellArg arg, uint8_t ip[4]);
+void isCommand(char line[], uint8_t size);
+bool shellPoll();
+void shellExecute(uint32_t arg);
 
 
 #endif
@@ -25,6 +25,7 @@
 #include "tm4c123gh6pm.h"
 #include "gpio.h"
 #include "spi0.h"
+#include "ramfunc.h"
 
 // Pins
 #define SSI0TX PORTA,5
@@ -75,9 +76,12 @@ void initSpi0(uint32_t pinMask)
 // Set baud rate as function of instruction cycle frequency
 void setSpi0BaudRate(uint32_t baudRate, uint32_t fcyc)
 {
-    uint32_t divisorTimes2 = (fcyc * 2) / baudRate;    // calculate divisor (r) times 2
+    uint32_t divisor = (fcyc + baudRate - 1) / baudRate;  // calculate divisor (r), rounded up
+    divisor = (divisor + 1) & ~1;                      // must be even (lsb reads as 0), at least 2
+    if (divisor < 2)
+        divisor = 2;
     SSI0_CR1_R &= ~SSI_CR1_SSE;                        // turn off SSI to allow re-configuration
-    SSI0_CPSR_R = (divisorTimes2 + 1) >> 1;            // round divisor to nearest integer
+    SSI0_CPSR_R = divisor;                             // never faster than baudRate
     SSI0_CR1_R |= SSI_CR1_SSE;                         // turn on SSI
 }
 
@@ -91,15 +95,24 @@ void setSpi0Mode(uint8_t polarity, uint8_t phase)
     SSI0_CR1_R |= SSI_CR1_SSE;                         // turn on SSI
 }
 
+// Set frame size (4 to 16 bits)
+// With SSI0Fss and phase 0, each frame gets its own chip select pulse
+void setSpi0DataSize(uint8_t bits)
+{
+    SSI0_CR1_R &= ~SSI_CR1_SSE;                        // turn off SSI to allow re-configuration
+    SSI0_CR0_R = (SSI0_CR0_R & ~SSI_CR0_DSS_M) | (bits - 1);
+    SSI0_CR1_R |= SSI_CR1_SSE;                         // turn on SSI
+}
+
 // Blocking function that writes data and waits until the tx buffer is empty
-void writeSpi0Data(uint32_t data)
+RAMFUNC void writeSpi0Data(uint32_t data)
 {
     SSI0_DR_R = data;
     while (SSI0_SR_R & SSI_SR_BSY);
 }
 
 // Reads data from the rx buffer after a write
-uint32_t readSpi0Data()
+RAMFUNC uint32_t readSpi0Data()
 {
     return SSI0_DR_R;
 }
@@ -0,0 +1,191 @@
+// Timer Wheel Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// SysTick interrupts every 1 ms and counts a 64-bit tick that never wraps.
+// Timers are kept in a hierarchical wheel (4 levels of 64 slots, as in the
+// classic BSD/Linux design): start and stop unlink or link one node, and
+// timerService() moves the timers of a higher level down one level each
+// time its slot comes round. Callbacks run from timerService() in the main
+// loop, never in the interrupt, so they may use the driver freely. The isr
+// hands each tick to the main loop through a ring, so polling for due work
+// does not read the 64-bit counter.
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "timer.h"
+#include "ring.h"
+
+#define TIMER_WHEEL_MASK  (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_RANGE (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+// Ticks not yet seen by the main loop; a full ring only loses wake-ups,
+// timerService() catches up from the counter
+#define TIMER_EVENT_RING_SIZE 4
+
+// ------------------------------------------------------------------------------
+//  Globals
+// ------------------------------------------------------------------------------
+
+volatile uint64_t timerTicks = 0;       // written by the isr only
+uint64_t wheelTime = 0;                 // next tick timerService() processes
+timer* wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+uint32_t timerEventData[TIMER_EVENT_RING_SIZE];
+ring timerEvents;                       // isr to main loop
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Starts the 1 ms SysTick interrupt
+void initTimer()
+{
+    NVIC_ST_CTRL_R = 0;
+    ringInit(&timerEvents, timerEventData, TIMER_EVENT_RING_SIZE, sizeof(uint32_t));
+    NVIC_ST_RELOAD_R = (SYSTEM_CLOCK / TIMER_TICKS_PER_SECOND) - 1;
+    NVIC_ST_CURRENT_R = 0;
+    NVIC_ST_CTRL_R = NVIC_ST_CTRL_CLK_SRC | NVIC_ST_CTRL_INTEN | NVIC_ST_CTRL_ENABLE;
+}
+
+void systickIsr()
+{
+    uint32_t tick = ++timerTicks;
+    ringPut(&timerEvents, &tick);
+}
+
+// The isr can update the counter between the two halves of the read,
+// so read until two reads agree
+uint64_t timerGetTicks()
+{
+    uint64_t ticks;
+    do
+        ticks = timerTicks;
+    while (ticks != timerTicks);
+    return ticks;
+}
+
+// Puts a timer in the slot for its expiry, the level is chosen by how far
+// away that is
+void timerLink(timer* t)
+{
+    uint64_t expires = t->expires;
+    uint8_t level = 0;
+    timer** slot;
+    if (expires < wheelTime)
+        expires = wheelTime;
+    if (expires - wheelTime >= TIMER_WHEEL_RANGE)
+        expires = wheelTime + TIMER_WHEEL_RANGE - 1;
+    while (level < TIMER_WHEEL_LEVELS - 1 && (expires - wheelTime) >> (TIMER_WHEEL_BITS * (level + 1)))
+        level++;
+    slot = &wheel[level][(expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK];
+    t->next = *slot;
+    if (t->next != NULL)
+        t->next->prev = &t->next;
+    t->prev = slot;
+    *slot = t;
+}
+
+void timerUnlink(timer* t)
+{
+    *t->prev = t->next;
+    if (t->next != NULL)
+        t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+// Runs callback(context) after delay ticks, then every period ticks if not 0
+// A running timer is restarted
+void timerStart(timer* t, uint32_t delay, uint32_t period, timerCallback callback, void* context)
+{
+    if (t->prev != NULL)
+        timerUnlink(t);
+    t->expires = timerGetTicks() + delay;
+    t->period = period;
+    t->callback = callback;
+    t->context = context;
+    timerLink(t);
+}
+
+void timerStop(timer* t)
+{
+    if (t->prev != NULL)
+        timerUnlink(t);
+}
+
+bool timerIsActive(const timer* t)
+{
+    return t->prev != NULL;
+}
+
+// Moves every timer in a slot of a higher level down
+void timerCascade(uint8_t level, uint8_t index)
+{
+    timer* t = wheel[level][index];
+    timer* next;
+    wheel[level][index] = NULL;
+    while (t != NULL)
+    {
+        next = t->next;
+        timerLink(t);
+        t = next;
+    }
+}
+
+// True when a tick has passed since the last call, so timerService() has
+// ticks to process
+bool timerIsDue()
+{
+    uint32_t tick;
+    bool due = false;
+    while (ringGet(&timerEvents, &tick))
+        due = true;
+    return due;
+}
+
+// Runs the callbacks of every timer due since the last call
+// Call from the main loop
+void timerService()
+{
+    uint64_t now = timerGetTicks();
+    uint8_t index, level;
+    timer* t;
+    while (wheelTime <= now)
+    {
+        // at the start of each round of a level, refill it from the level above
+        index = wheelTime & TIMER_WHEEL_MASK;
+        for (level = 1; level < TIMER_WHEEL_LEVELS && index == 0; level++)
+        {
+            index = (wheelTime >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            timerCascade(level, index);
+        }
+
+        // a callback can start timers in this slot, they run in this pass
+        index = wheelTime & TIMER_WHEEL_MASK;
+        while ((t = wheel[0][index]) != NULL)
+        {
+            timerUnlink(t);
+            if (t->period != 0)
+            {
+                t->expires += t->period;
+                timerLink(t);
+            }
+            if (t->callback != NULL)
+                t->callback(t->context);
+        }
+        wheelTime++;
+    }
+}
@@ -0,0 +1,59 @@
+// Timer Wheel Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// SysTick rate, one tick is 1 ms
+#define TIMER_TICKS_PER_SECOND 1000
+#define TIMER_MS(ms)           ((uint32_t)(ms) * (TIMER_TICKS_PER_SECOND / 1000))
+#define TIMER_SECONDS(s)       ((uint32_t)(s) * TIMER_TICKS_PER_SECOND)
+
+// 4 levels of 64 slots cover 2^24 ticks (4.6 hours at 1 ms)
+// Longer timers are parked in the last slot and placed again when it comes round
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SIZE   (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+typedef void (*timerCallback)(void* context);
+
+// Owned by the caller and zeroed before first use (static storage is)
+// The wheel only links it in, there is no allocation
+typedef struct _timer
+{
+  struct _timer* next;
+  struct _timer** prev;     // link pointing at this timer, NULL when not running
+  uint64_t expires;         // tick
+  uint32_t period;          // ticks, 0 for one-shot
+  timerCallback callback;   // may be NULL to just poll timerIsActive()
+  void* context;
+} timer;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initTimer();
+uint64_t timerGetTicks();
+void timerStart(timer* t, uint32_t delay, uint32_t period, timerCallback callback, void* context);
+void timerStop(timer* t);
+bool timerIsActive(const timer* t);
+bool timerIsDue();
+void timerService();
+void systickIsr();
+
+#endif
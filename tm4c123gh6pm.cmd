@@ -36,6 +36,13 @@ SECTIONS
     .init_array : > FLASH
 
     .vtable :   > 0x20000000
+
+    /* Functions marked RAMFUNC (ramfunc.h), stored in flash and copied to  */
+    /* SRAM by ResetISR before _c_int00 runs                                 */
+    .ramfunc :  load = FLASH, run = SRAM, palign(4),
+                LOAD_START(__ramfunc_load), RUN_START(__ramfunc_run),
+                SIZE(__ramfunc_size)
+
     .data   :   > SRAM
     .bss    :   > SRAM
     .sysmem :   > SRAM
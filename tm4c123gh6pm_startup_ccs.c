@@ -49,6 +49,17 @@ extern void _c_int00(void);
 //*****************************************************************************
 extern uint32_t __STACK_TOP;
 
+//*****************************************************************************
+//
+// Linker variables that locate the functions run from SRAM (see ramfunc.h).
+//
+//*****************************************************************************
+#ifdef USE_RAMFUNC
+extern uint32_t __ramfunc_load;
+extern uint32_t __ramfunc_run;
+extern uint32_t __ramfunc_size;
+#endif
+
 
 //*****************************************************************************
 //
@@ -56,6 +67,9 @@ extern uint32_t __STACK_TOP;
 //
 //*****************************************************************************
 // To be added by user
+extern void uart0Isr(void);
+extern void systickIsr(void);
+extern void etherIsr(void);
 
 //*****************************************************************************
 //
@@ -83,13 +97,13 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // Debug monitor handler
     0,                                      // Reserved
     IntDefaultHandler,                      // The PendSV handler
-    IntDefaultHandler,                      // The SysTick handler
+    systickIsr,                             // The SysTick handler
     IntDefaultHandler,                      // GPIO Port A
     IntDefaultHandler,                      // GPIO Port B
-    IntDefaultHandler,                      // GPIO Port C
+    etherIsr,                               // GPIO Port C
     IntDefaultHandler,                      // GPIO Port D
     IntDefaultHandler,                      // GPIO Port E
-    IntDefaultHandler,                      // UART0 Rx and Tx
+    uart0Isr,                               // UART0 Rx and Tx
     IntDefaultHandler,                      // UART1 Rx and Tx
     IntDefaultHandler,                      // SSI0 Rx and Tx
     IntDefaultHandler,                      // I2C0 Master and Slave
@@ -238,6 +252,24 @@ void (* const g_pfnVectors[])(void) =
 void
 ResetISR(void)
 {
+#ifdef USE_RAMFUNC
+    uint32_t *pui32Src, *pui32Dest;
+    uint32_t ui32Words;
+
+    //
+    // Copy the RAMFUNC code from flash to SRAM, so it is in place before
+    // anything in _c_int00 or main can call it.  The linker pads the
+    // section to a word multiple.
+    //
+    pui32Src = &__ramfunc_load;
+    pui32Dest = &__ramfunc_run;
+    ui32Words = (uint32_t)&__ramfunc_size / 4;
+    while(ui32Words--)
+    {
+        *pui32Dest++ = *pui32Src++;
+    }
+#endif
+
     //
     // Jump to the CCS C initialization routine.  This will enable the
     // floating-point unit as well, so that does not need to be done here.
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Decodes the binary log records in a console capture.
+
+Usage:
+    logdecode.py [--header ../log.h] [--clock 80000000] capture.bin
+    logdecode.py --port /dev/ttyACM0       (needs pyserial)
+
+Console text is passed through unchanged; each record (see log.h) is
+printed as "[seconds] message". Ids map to the LOG_MSG formats in log.h in
+order. %u, %x, %04x, ... format an argument as printf would and %ip
+formats it as a dotted quad.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+LOG_SYNC = 0xA5
+HEADER_SIZE = 8
+
+
+def load_messages(header):
+    with open(header) as f:
+        text = f.read()
+    return [fmt for _, fmt in re.findall(r'LOG_MSG\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', text)]
+
+
+def format_message(fmt, args):
+    args = list(args)
+
+    def substitute(match):
+        if not args:
+            return match.group(0)
+        value = args.pop(0)
+        if match.group(0) == '%ip':
+            return '.'.join(str((value >> shift) & 0xFF) for shift in (24, 16, 8, 0))
+        return match.group(0) % value
+
+    return re.sub(r'%ip|%[-0-9]*[uxXd]', substitute, fmt)
+
+
+class Decoder:
+    def __init__(self, messages, clock, out):
+        self.messages = messages
+        self.clock = clock
+        self.out = out
+        self.buffer = bytearray()
+        self.last = None
+        self.elapsed = 0
+        self.line_start = True
+
+    def timestamp(self, cycles):
+        # the cycle counter wraps every 2^32 cycles (53.7 s at 80 MHz)
+        if self.last is not None:
+            self.elapsed += (cycles - self.last) & 0xFFFFFFFF
+        self.last = cycles
+        return self.elapsed / self.clock
+
+    def feed(self, data):
+        self.buffer += data
+        while self.buffer:
+            if self.buffer[0] != LOG_SYNC:
+                end = self.buffer.find(LOG_SYNC)
+                if end < 0:
+                    end = len(self.buffer)
+                text = self.buffer[:end].decode('ascii', 'replace')
+                self.out.write(text)
+                self.line_start = text.endswith(('\n', '\r'))
+                del self.buffer[:end]
+                continue
+            if len(self.buffer) < HEADER_SIZE:
+                return
+            msg_id, count, cycles = struct.unpack_from('<HBI', self.buffer, 1)
+            size = HEADER_SIZE + 4 * count
+            if len(self.buffer) < size:
+                return
+            args = struct.unpack_from('<%dI' % count, self.buffer, HEADER_SIZE)
+            del self.buffer[:size]
+            if msg_id < len(self.messages):
+                text = format_message(self.messages[msg_id], args)
+            else:
+                text = 'unknown id %u %s' % (msg_id, ' '.join('0x%08x' % a for a in args))
+            if not self.line_start:
+                self.out.write('\n')
+            self.out.write('[%10.6f] %s\n' % (self.timestamp(cycles), text))
+            self.line_start = True
+        self.out.flush()
+
+
+def main():
+    default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'log.h')
+    parser = argparse.ArgumentParser(description='Decode binary log records')
+    parser.add_argument('capture', nargs='?', help='raw console capture (default stdin)')
+    parser.add_argument('--header', default=default_header, help='path to log.h')
+    parser.add_argument('--clock', type=float, default=80e6, help='system clock in Hz')
+    parser.add_argument('--port', help='read from a serial port instead')
+    parser.add_argument('--baud', type=int, default=115200)
+    options = parser.parse_args()
+
+    decoder = Decoder(load_messages(options.header), options.clock, sys.stdout)
+    if options.port:
+        import serial
+        with serial.Serial(options.port, options.baud) as port:
+            while True:
+                decoder.feed(port.read(max(1, port.in_waiting)))
+    else:
+        stream = open(options.capture, 'rb') if options.capture else sys.stdin.buffer
+        with stream:
+            decoder.feed(stream.read())
+
+
+if __name__ == '__main__':
+    main()
@@ -20,17 +20,32 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "uart0.h"
+#include "ring.h"
 
 // PortA masks
 #define UART_TX_MASK 2
 #define UART_RX_MASK 1
 
+// Ring sizes must be powers of 2
+#define UART0_TX_RING_SIZE 512
+#define UART0_RX_RING_SIZE 128
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+// Filled by the main loop, drained by uart0Isr
+char uart0TxData[UART0_TX_RING_SIZE];
+ring uart0TxRing;
+
+// Filled by uart0Isr, read by the main loop
+char uart0RxData[UART0_RX_RING_SIZE];
+ring uart0RxRing;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -38,8 +53,8 @@
 // Initialize UART0
 void initUart0()
 {
-    // Configure HW to work with 16 MHz XTAL, PLL enabled, system clock of 40 MHz
-    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | (4 << SYSCTL_RCC_SYSDIV_S);
+    ringInit(&uart0TxRing, uart0TxData, UART0_TX_RING_SIZE, 1);
+    ringInit(&uart0RxRing, uart0RxData, UART0_RX_RING_SIZE, 1);
 
     // Set GPIO ports to use APB (not needed since default configuration -- for clarity)
     SYSCTL_GPIOHBCTL_R = 0;
@@ -61,10 +76,12 @@ void initUart0()
 
     // Configure UART0 to 115200 baud, 8N1 format
     UART0_CTL_R = 0;                                    // turn-off UART0 to allow safe programming
-    UART0_CC_R = UART_CC_CS_SYSCLK;                     // use system clock (40 MHz)
-    UART0_IBRD_R = 21;                                  // r = 40 MHz / (Nx115.2kHz), set floor(r)=21, where N=16
-    UART0_FBRD_R = 45;                                  // round(fract(r)*64)=45
+    UART0_CC_R = UART_CC_CS_SYSCLK;                     // use system clock (set up by initClock)
+    setUart0BaudRate(115200, SYSTEM_CLOCK);             // r = SYSTEM_CLOCK / (Nx115.2kHz), where N=16
     UART0_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;    // configure for 8N1 w/ 16-level FIFO
+    UART0_IFLS_R = UART_IFLS_RX4_8 | UART_IFLS_TX2_8;   // refill tx fifo when it drops to 4 characters
+    UART0_IM_R = UART_IM_RXIM | UART_IM_RTIM;           // rx interrupts now, tx only while the ring has data
+    NVIC_EN0_R |= 1 << (INT_UART0-16);                  // turn-on interrupt 21 (UART0)
     UART0_CTL_R = UART_CTL_TXE | UART_CTL_RXE | UART_CTL_UARTEN;
                                                         // enable TX, RX, and module
 }
@@ -78,30 +95,103 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
     UART0_FBRD_R = ((divisorTimes128 + 1)) >> 1 & 63;    // set fractional value to round(fract(r)*64)
 }
 
-// Blocking function that writes a serial character when the UART buffer is not full
+// Moves characters from the tx ring to the fifo until either is exhausted
+// Called with the tx interrupt masked or from uart0Isr
+void fillUart0TxFifo()
+{
+    char c;
+    while (!(UART0_FR_R & UART_FR_TXFF) && ringGet(&uart0TxRing, &c))
+        UART0_DR_R = c;
+    if (!ringIsEmpty(&uart0TxRing))
+        UART0_IM_R |= UART_IM_TXIM;
+}
+
+// Starts transmission if the tx interrupt is idle
+void startUart0Tx()
+{
+    UART0_IM_R &= ~UART_IM_TXIM;
+    fillUart0TxFifo();
+}
+
+// Returns the number of characters that can be queued without waiting
+uint16_t getUart0TxFree()
+{
+    return ringFree(&uart0TxRing);
+}
+
+// Queues size characters for transmission
+// UART0_BLOCK waits for room in the ring when it is full
+// UART0_DROP never waits and drops all of data if it does not fit
+// Returns false if data was dropped
+bool writeUart0(const char data[], uint16_t size, uint8_t policy)
+{
+    uint16_t i;
+    if (policy == UART0_DROP && size > getUart0TxFree())
+    {
+        uart0TxRing.dropped += size;
+        return false;
+    }
+    for (i = 0; i < size; i++)
+    {
+        // ring full, let the interrupt drain it
+        while (ringFree(&uart0TxRing) == 0);
+        ringPut(&uart0TxRing, &data[i]);
+        // start early so a long blocking write keeps the fifo busy
+        if ((i & 15) == 15)
+            startUart0Tx();
+    }
+    startUart0Tx();
+    return true;
+}
+
+// Writes a serial character, waiting if the tx ring is full
 void putcUart0(char c)
 {
-    while (UART0_FR_R & UART_FR_TXFF);               // wait if uart0 tx fifo full
-    UART0_DR_R = c;                                  // write character to fifo
+    writeUart0(&c, 1, UART0_BLOCK);
 }
 
-// Blocking function that writes a string when the UART buffer is not full
+// Writes a string, waiting if the tx ring is full
 void putsUart0(char* str)
 {
-    uint8_t i = 0;
-    while (str[i] != '\0')
-        putcUart0(str[i++]);
+    writeUart0(str, strlen(str), UART0_BLOCK);
+}
+
+// Writes a string only if it fits in the tx ring, never waits
+// Use on paths where dropping console output beats stalling the network
+bool putsUart0NoWait(char* str)
+{
+    return writeUart0(str, strlen(str), UART0_DROP);
 }
 
 // Blocking function that returns with serial data once the buffer is not empty
 char getcUart0()
 {
-    while (UART0_FR_R & UART_FR_RXFE);               // wait if uart0 rx fifo empty
-    return UART0_DR_R & 0xFF;                        // get character from fifo
+    char c;
+    while (!ringGet(&uart0RxRing, &c));               // wait if rx ring empty
+    return c;
 }
 
 // Returns the status of the receive buffer
 bool kbhitUart0()
 {
-    return !(UART0_FR_R & UART_FR_RXFE);
+    return !ringIsEmpty(&uart0RxRing);
+}
+
+// Moves received characters to the rx ring and refills the tx fifo
+void uart0Isr()
+{
+    char c;
+    // a full ring drops the newest character
+    while (!(UART0_FR_R & UART_FR_RXFE))
+    {
+        c = UART0_DR_R & 0xFF;
+        ringPut(&uart0RxRing, &c);
+    }
+    if (UART0_MIS_R & UART_MIS_TXMIS)
+    {
+        UART0_IM_R &= ~UART_IM_TXIM;
+        UART0_ICR_R = UART_ICR_TXIC;
+        fillUart0TxFifo();
+    }
+    UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
 }
@@ -21,6 +21,13 @@
 #ifndef UART0_H_
 #define UART0_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Overflow policy when the tx ring is full
+#define UART0_BLOCK 0
+#define UART0_DROP  1
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -29,7 +36,11 @@ void initUart0();
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc);
 void putcUart0(char c);
 void putsUart0(char* str);
+bool putsUart0NoWait(char* str);
+bool writeUart0(const char data[], uint16_t size, uint8_t policy);
+uint16_t getUart0TxFree();
 char getcUart0();
 bool kbhitUart0();
+void uart0Isr();
 
 #endif
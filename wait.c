@@ -6,7 +6,7 @@
 //-----------------------------------------------------------------------------
 
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 //-----------------------------------------------------------------------------
 // Device includes, defines, and assembler directives
@@ -15,25 +15,19 @@
 #include <stdint.h>
 #include "tm4c123gh6pm.h"
 #include "wait.h"
+#include "clock.h"
+
+// Decrement, compare and branch of the loop in waitMicrosecond
+#define WAIT_LOOP_CYCLES 4
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// Approximate busy waiting (in units of microseconds), given a 40 MHz system clock
+// Approximate busy waiting (in units of microseconds), calibrated from SYSTEM_CLOCK
+// _delay_cycles is exact, the loop around it adds about WAIT_LOOP_CYCLES per us
 void waitMicrosecond(uint32_t us)
 {
-    __asm("             MOV  R3, R0");          // 1
-	__asm("WMS_LOOP0:   MOV  R1, #6");          // 1
-    __asm("WMS_LOOP1:   SUB  R1, #1");          // 6
-    __asm("             CBZ  R1, WMS_DONE1");   // 5+1*3
-    __asm("             NOP");                  // 5
-    __asm("             NOP");                  // 5
-    __asm("             B    WMS_LOOP1");       // 5*2 (speculative, so P=1)
-    __asm("WMS_DONE1:   SUB  R3, #1");          // 1
-    __asm("             CBZ  R3, WMS_DONE0");   // 1
-	__asm("             NOP");                  // 1
-    __asm("             B    WMS_LOOP0");       // 1*2 (speculative, so P=1)
-    __asm("WMS_DONE0:");                        // ---
-                                                // 40 clocks/us + error
+    while (us--)
+        _delay_cycles(CLOCKS_PER_US - WAIT_LOOP_CYCLES);
 }